@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mcts.hpp"
+#include "thread_pool.hpp"
+#include "util.hpp"
+
+namespace mcts
+{
+
+/**
+ * settings for a beam search
+ */
+struct beam_config {
+  // the number of states kept at each depth
+  std::size_t width = 1000;
+  // the number of threads expanding states
+  std::size_t num_threads = 1;
+  // the number of seconds of wall-clock time the search may take, or 0 for
+  // no limit
+  double time_limit = 0;
+};
+
+/**
+ * Beam search for single-player games. The beam starts as the root. At each
+ * depth every state in the beam is expanded, its children are scored by their
+ * cumulative reward plus an optional heuristic, and the best width of them
+ * become the next beam. Children with no moves left are games played to the
+ * end, which are kept as the best sequence if they score the highest so far.
+ *
+ * The beam's states are expanded in parallel on a thread pool. If the game has
+ * a hash() (see has_hash), children with the same hash are taken to be the
+ * same state reached by different move orders and only the one with the
+ * highest reward is kept. Each child is built to score it, but only its score,
+ * its hash, its parent and its move are kept. The best width children are
+ * picked with a partial sort, and only those are built again to form the next
+ * beam.
+ *
+ * Memory use is bounded by the width: the search keeps two beams of states,
+ * the scores of the children of one beam and, to rebuild sequences, a parent
+ * index and a move for each state of each depth so far.
+ *
+ * Once the time limit passes or stop() is called the beam narrows to its best
+ * state, which is played out greedily, so a search always ends with a whole
+ * game shortly after.
+ */
+template <class Game>
+class beam_search {
+  public:
+    using move_type = typename Game::move_type;
+    using status_type = search_status<move_type>;
+    using heuristic_type = std::function<double(const Game&)>;
+  private:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * how a state in the beam was reached from the previous beam
+     */
+    struct step {
+      index_type parent;
+      move_type move;
+    };
+
+    /**
+     * a child of a state in the beam, before it is known to make the cut
+     */
+    struct candidate {
+      double priority;
+      double reward;
+      std::uint64_t hash;
+      index_type parent;
+      index_type move_index;
+    };
+
+    Game root_;
+    beam_config cfg_;
+    heuristic_type heuristic_;
+    thread_pool pool_;
+    // steps_[d][i] is how state i of the beam at depth d + 1 was reached
+    std::vector<std::vector<step>> steps_;
+    std::mutex best_mutex_;
+    double high_score_;
+    std::vector<move_type> best_seq_;
+    std::atomic<std::size_t> num_expanded_;
+    std::atomic<bool> searching_;
+    std::atomic<bool> stop_requested_;
+    std::atomic<clock::time_point> start_;
+    std::atomic<clock::time_point> end_;
+    clock::time_point deadline_;
+
+    static const beam_config& check(const beam_config& cfg) {
+      if (cfg.width == 0) {
+        throw std::invalid_argument("beam search needs a width of at least 1");
+      }
+      if (cfg.num_threads == 0) {
+        throw std::invalid_argument("beam search needs at least one thread");
+      }
+      return cfg;
+    }
+
+    bool should_stop() const noexcept {
+      return stop_requested_.load(std::memory_order_relaxed) || clock::now() >= deadline_;
+    }
+
+    /**
+     * rebuilds the moves leading to a state of the beam
+     *
+     * @param depth the depth of the beam
+     * @param i the index of the state in the beam
+     * @return the moves from the root to the state
+     */
+    std::vector<move_type> get_seq(std::size_t depth, index_type i) const {
+      std::vector<move_type> seq(depth);
+      for (std::size_t d = depth; d > 0; d--) {
+        const step& s = steps_[d - 1][i];
+        seq[d - 1] = s.move;
+        i = s.parent;
+      }
+      return seq;
+    }
+
+    /**
+     * keeps a game played to the end if it scores the highest so far
+     */
+    void record(double score, std::size_t depth, index_type parent, const move_type& move) {
+      std::lock_guard<std::mutex> guard(best_mutex_);
+      if (score > high_score_) {
+        high_score_ = score;
+        best_seq_ = get_seq(depth, parent);
+        best_seq_.push_back(move);
+      }
+    }
+
+    /**
+     * scores the children of a state of the beam
+     *
+     * @param state the state
+     * @param depth the depth of the beam
+     * @param i the index of the state in the beam
+     * @param out the vector to put the children which have moves left in
+     */
+    void expand(const Game& state, std::size_t depth, index_type i, std::vector<candidate>& out) {
+      out.clear();
+      const auto& moves = state.get_available_moves();
+      for (std::size_t j = 0; j < moves.size(); j++) {
+        Game child(state);
+        child.apply(moves[j]);
+        double reward = child.get_cumulative_reward();
+        if (child.get_available_moves().empty()) {
+          record(reward, depth, i, moves[j]);
+          continue;
+        }
+        std::uint64_t hash = 0;
+        if constexpr (has_hash<Game>::value) {
+          hash = child.hash();
+        }
+        double priority = heuristic_ ? reward + heuristic_(child) : reward;
+        out.push_back({priority, reward, hash, i, static_cast<index_type>(j)});
+      }
+      num_expanded_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * merges children with the same hash, keeping the one with the highest
+     * reward
+     */
+    static void deduplicate(std::vector<candidate>& children) {
+      std::unordered_map<std::uint64_t, std::size_t> seen;
+      seen.reserve(children.size());
+      std::size_t n = 0;
+      for (const candidate& c : children) {
+        auto [it, inserted] = seen.try_emplace(c.hash, n);
+        if (inserted) {
+          children[n++] = c;
+        } else if (c.reward > children[it->second].reward) {
+          children[it->second] = c;
+        }
+      }
+      children.resize(n);
+    }
+
+  public:
+    /**
+     * beam_search constructor. throws std::invalid_argument if the width or
+     * the number of threads is 0
+     *
+     * @param root the game state to search from
+     * @param cfg the settings of the search
+     * @param heuristic an estimate of the reward still to come from a state,
+     * added to its cumulative reward to rank it, or none to rank by cumulative
+     * reward alone. it is called from the expanding threads at once
+     */
+    beam_search(const Game& root, const beam_config& cfg, heuristic_type heuristic = nullptr)
+      : root_(root),
+        cfg_(check(cfg)),
+        heuristic_(std::move(heuristic)),
+        pool_(cfg_.num_threads - 1),
+        high_score_(-std::numeric_limits<double>::max()),
+        num_expanded_(0),
+        searching_(false),
+        stop_requested_(false),
+        start_(clock::time_point()),
+        end_(clock::time_point())
+    {}
+
+    /**
+     * asks the current search to narrow its beam to its best state and play
+     * that out greedily. may be called from any thread.
+     */
+    void stop() noexcept {
+      stop_requested_.store(true);
+    }
+
+    /**
+     * takes a snapshot of the current or last search. may be called from any
+     * thread while the search runs. num_iterations counts expanded states, and
+     * root_visits is left empty as there is no tree.
+     *
+     * @return the status of the search
+     */
+    status_type get_status() {
+      status_type status;
+      status.num_iterations = num_expanded_.load();
+      clock::time_point end = searching_.load() ? clock::now() : end_.load();
+      status.seconds = std::chrono::duration<double>(end - start_.load()).count();
+      std::lock_guard<std::mutex> guard(best_mutex_);
+      status.high_score = high_score_;
+      status.best_seq = best_seq_;
+      return status;
+    }
+
+    /**
+     * runs a search without printing anything
+     *
+     * @return the status at the end of the search
+     */
+    status_type explore() {
+      clock::time_point start = clock::now();
+      start_ = start;
+      deadline_ = clock::time_point::max();
+      if (cfg_.time_limit > 0) {
+        deadline_ = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(cfg_.time_limit));
+      }
+      num_expanded_ = 0;
+      stop_requested_ = false;
+      searching_ = true;
+      steps_.clear();
+      {
+        std::lock_guard<std::mutex> guard(best_mutex_);
+        high_score_ = -std::numeric_limits<double>::max();
+        if (root_.get_available_moves().empty()) {
+          high_score_ = root_.get_cumulative_reward();
+        }
+        best_seq_.clear();
+      }
+
+      std::vector<Game> beam{root_};
+      std::vector<Game> next;
+      std::vector<std::vector<candidate>> children;
+      std::vector<candidate> cut;
+      for (std::size_t depth = 0; !beam.empty(); depth++) {
+        children.resize(beam.size());
+        pool_.run(beam.size(), [&](std::size_t i) {
+          // past the deadline only the best state goes on, so don't wait for
+          // the rest of a wide beam
+          if (i > 0 && should_stop()) {
+            children[i].clear();
+            return;
+          }
+          expand(beam[i], depth, static_cast<index_type>(i), children[i]);
+        });
+
+        cut.clear();
+        for (std::size_t i = 0; i < beam.size(); i++) {
+          cut.insert(cut.end(), children[i].begin(), children[i].end());
+        }
+        if constexpr (has_hash<Game>::value) {
+          deduplicate(cut);
+        }
+        std::size_t width = should_stop() ? 1 : cfg_.width;
+        width = std::min(width, cut.size());
+        std::partial_sort(cut.begin(), cut.begin() + width, cut.end(),
+          [](const candidate& a, const candidate& b) { return a.priority > b.priority; });
+        cut.resize(width);
+
+        steps_.emplace_back(width);
+        next.resize(width, root_);
+        pool_.run(width, [&](std::size_t i) {
+          const candidate& c = cut[i];
+          const Game& parent = beam[c.parent];
+          move_type move = parent.get_available_moves()[c.move_index];
+          steps_[depth][i] = {c.parent, move};
+          next[i] = parent;
+          next[i].apply(move);
+        });
+        beam.swap(next);
+      }
+
+      end_ = clock::now();
+      searching_ = false;
+      return get_status();
+    }
+
+    /**
+     * runs a search and prints the best sequence it found and the time it took
+     */
+    void search() {
+      status_type status = explore();
+      std::cout << "High score: " << status.high_score << std::endl;
+      std::cout << "High scoring sequence of moves: ";
+      print(status.best_seq);
+      std::cout << "Took " << status.seconds << "s " << "(" << (status.num_iterations / status.seconds)
+        << " states expanded per second on " << cfg_.num_threads << " threads)" << std::endl;
+    }
+};
+
+}
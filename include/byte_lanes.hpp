@@ -0,0 +1,254 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * N unsigned bytes which are operated on together, one per lane. Comparisons
+ * give masks holding 0xFF in the lanes where they hold and 0 elsewhere, which
+ * can then be combined with the bitwise operators or used to blend. Arithmetic
+ * wraps around like it does for uint8_t.
+ *
+ * The generic version is written as plain loops for the compiler to vectorize.
+ * The 16 lane version uses SSE2 and, when built with AVX2 enabled, the 32 lane
+ * version uses AVX2, so that every operation is a single instruction or two.
+ */
+template <int N>
+class byte_lanes {
+  private:
+    std::array<std::uint8_t, N> v_;
+
+    template <class F>
+    static byte_lanes map(byte_lanes a, byte_lanes b, F f) noexcept {
+      byte_lanes r;
+      for (int i = 0; i < N; i++) {
+        r.v_[i] = f(a.v_[i], b.v_[i]);
+      }
+      return r;
+    }
+  public:
+    static byte_lanes splat(std::uint8_t x) noexcept {
+      byte_lanes r;
+      r.v_.fill(x);
+      return r;
+    }
+
+    static byte_lanes load(const std::uint8_t* src) noexcept {
+      byte_lanes r;
+      for (int i = 0; i < N; i++) {
+        r.v_[i] = src[i];
+      }
+      return r;
+    }
+
+    void store(std::uint8_t* dst) const noexcept {
+      for (int i = 0; i < N; i++) {
+        dst[i] = v_[i];
+      }
+    }
+
+    std::uint8_t lane(int i) const noexcept {
+      return v_[i];
+    }
+
+    friend byte_lanes operator&(byte_lanes a, byte_lanes b) noexcept {
+      return map(a, b, [](std::uint8_t x, std::uint8_t y) -> std::uint8_t { return x & y; });
+    }
+
+    friend byte_lanes operator|(byte_lanes a, byte_lanes b) noexcept {
+      return map(a, b, [](std::uint8_t x, std::uint8_t y) -> std::uint8_t { return x | y; });
+    }
+
+    friend byte_lanes operator~(byte_lanes a) noexcept {
+      return map(a, a, [](std::uint8_t x, std::uint8_t) -> std::uint8_t { return ~x; });
+    }
+
+    friend byte_lanes operator+(byte_lanes a, byte_lanes b) noexcept {
+      return map(a, b, [](std::uint8_t x, std::uint8_t y) -> std::uint8_t { return x + y; });
+    }
+
+    friend byte_lanes operator-(byte_lanes a, byte_lanes b) noexcept {
+      return map(a, b, [](std::uint8_t x, std::uint8_t y) -> std::uint8_t { return x - y; });
+    }
+
+    /**
+     * @return ~a & b
+     */
+    friend byte_lanes andnot(byte_lanes a, byte_lanes b) noexcept {
+      return map(a, b, [](std::uint8_t x, std::uint8_t y) -> std::uint8_t { return ~x & y; });
+    }
+
+    friend byte_lanes min(byte_lanes a, byte_lanes b) noexcept {
+      return map(a, b, [](std::uint8_t x, std::uint8_t y) { return x < y ? x : y; });
+    }
+
+    friend byte_lanes eq(byte_lanes a, byte_lanes b) noexcept {
+      return map(a, b, [](std::uint8_t x, std::uint8_t y) -> std::uint8_t { return x == y ? 0xFF : 0; });
+    }
+
+    /**
+     * @return b in the lanes where mask is set and a everywhere else
+     */
+    friend byte_lanes blend(byte_lanes a, byte_lanes b, byte_lanes mask) noexcept {
+      return (a & ~mask) | (b & mask);
+    }
+
+    /**
+     * @return true if any bit is set in any lane
+     */
+    friend bool any(byte_lanes a) noexcept {
+      std::uint8_t r = 0;
+      for (int i = 0; i < N; i++) {
+        r |= a.v_[i];
+      }
+      return r != 0;
+    }
+};
+
+#ifdef __SSE2__
+template <>
+class byte_lanes<16> {
+  private:
+    __m128i v_;
+
+    explicit byte_lanes(__m128i v) noexcept
+      : v_(v)
+    {}
+  public:
+    byte_lanes() = default;
+
+    static byte_lanes splat(std::uint8_t x) noexcept {
+      return byte_lanes(_mm_set1_epi8(static_cast<char>(x)));
+    }
+
+    static byte_lanes load(const std::uint8_t* src) noexcept {
+      return byte_lanes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+    }
+
+    void store(std::uint8_t* dst) const noexcept {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v_);
+    }
+
+    std::uint8_t lane(int i) const noexcept {
+      alignas(16) std::uint8_t v[16];
+      _mm_store_si128(reinterpret_cast<__m128i*>(v), v_);
+      return v[i];
+    }
+
+    friend byte_lanes operator&(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm_and_si128(a.v_, b.v_));
+    }
+
+    friend byte_lanes operator|(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm_or_si128(a.v_, b.v_));
+    }
+
+    friend byte_lanes operator~(byte_lanes a) noexcept {
+      return byte_lanes(_mm_xor_si128(a.v_, _mm_set1_epi8(-1)));
+    }
+
+    friend byte_lanes operator+(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm_add_epi8(a.v_, b.v_));
+    }
+
+    friend byte_lanes operator-(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm_sub_epi8(a.v_, b.v_));
+    }
+
+    friend byte_lanes andnot(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm_andnot_si128(a.v_, b.v_));
+    }
+
+    friend byte_lanes min(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm_min_epu8(a.v_, b.v_));
+    }
+
+    friend byte_lanes eq(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm_cmpeq_epi8(a.v_, b.v_));
+    }
+
+    friend byte_lanes blend(byte_lanes a, byte_lanes b, byte_lanes mask) noexcept {
+      return byte_lanes(_mm_or_si128(_mm_andnot_si128(mask.v_, a.v_), _mm_and_si128(mask.v_, b.v_)));
+    }
+
+    friend bool any(byte_lanes a) noexcept {
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(a.v_, _mm_setzero_si128())) != 0xFFFF;
+    }
+};
+#endif
+
+#ifdef __AVX2__
+template <>
+class byte_lanes<32> {
+  private:
+    __m256i v_;
+
+    explicit byte_lanes(__m256i v) noexcept
+      : v_(v)
+    {}
+  public:
+    byte_lanes() = default;
+
+    static byte_lanes splat(std::uint8_t x) noexcept {
+      return byte_lanes(_mm256_set1_epi8(static_cast<char>(x)));
+    }
+
+    static byte_lanes load(const std::uint8_t* src) noexcept {
+      return byte_lanes(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)));
+    }
+
+    void store(std::uint8_t* dst) const noexcept {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v_);
+    }
+
+    std::uint8_t lane(int i) const noexcept {
+      alignas(32) std::uint8_t v[32];
+      _mm256_store_si256(reinterpret_cast<__m256i*>(v), v_);
+      return v[i];
+    }
+
+    friend byte_lanes operator&(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm256_and_si256(a.v_, b.v_));
+    }
+
+    friend byte_lanes operator|(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm256_or_si256(a.v_, b.v_));
+    }
+
+    friend byte_lanes operator~(byte_lanes a) noexcept {
+      return byte_lanes(_mm256_xor_si256(a.v_, _mm256_set1_epi8(-1)));
+    }
+
+    friend byte_lanes operator+(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm256_add_epi8(a.v_, b.v_));
+    }
+
+    friend byte_lanes operator-(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm256_sub_epi8(a.v_, b.v_));
+    }
+
+    friend byte_lanes andnot(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm256_andnot_si256(a.v_, b.v_));
+    }
+
+    friend byte_lanes min(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm256_min_epu8(a.v_, b.v_));
+    }
+
+    friend byte_lanes eq(byte_lanes a, byte_lanes b) noexcept {
+      return byte_lanes(_mm256_cmpeq_epi8(a.v_, b.v_));
+    }
+
+    friend byte_lanes blend(byte_lanes a, byte_lanes b, byte_lanes mask) noexcept {
+      return byte_lanes(_mm256_blendv_epi8(a.v_, b.v_, mask.v_));
+    }
+
+    friend bool any(byte_lanes a) noexcept {
+      return !_mm256_testz_si256(a.v_, a.v_);
+    }
+};
+#endif
@@ -3,8 +3,10 @@
 #include <map>
 #include <mutex>
 #include <queue>
+#include <random>
 #include <thread>
 
+#include "playout_state.hpp"
 #include "simulator_node.hpp"
 #include "util.hpp"
 
@@ -52,18 +54,8 @@ class deep_tree_simulator {
       pri_q_.push(&root_);
     }
 
-    void rollout(node_type* node, std::vector<state_statistics>& range_stats) {
-      std::vector<double> rewards;
-      for (int i = 0; i < rollouts_per_node_; i++) {
-        Game g(node->get_game());
-        auto moves = g.get_available_moves();
-        while (!moves.empty()) {
-          int random_idx = std::rand() % moves.size();
-          g = g.make_move(moves[random_idx]);
-          moves = g.get_available_moves();
-        }
-        rewards.push_back(g.get_cumulative_reward());
-      } 
+    void rollout(node_type* node, std::vector<state_statistics>& range_stats, std::minstd_rand& rng) {
+      std::vector<double> rewards = play_out_many(node->get_game(), rollouts_per_node_, rng);
 
       double reward_mean = mean(rewards);
       double reward_sd = stddev(rewards);
@@ -83,6 +75,8 @@ class deep_tree_simulator {
     void rollout_range(std::vector<node_type*>& wl, std::size_t start_idx, 
         std::size_t end_idx, std::size_t& progress) {
       std::vector<state_statistics> range_stats;
+      // each worker draws from its own generator rather than contending on std::rand
+      std::minstd_rand rng(std::rand());
       for (std::size_t i = start_idx; i < wl.size() && i < end_idx; i++) {
         if (i % 1000 == 0 && i != 0) {
           std::lock_guard progress_guard(progress_mutex_);
@@ -91,7 +85,7 @@ class deep_tree_simulator {
             << (progress / static_cast<float>(wl.size()) * 100) 
             << "%)" << std::endl;
         }
-        rollout(wl[i], range_stats);
+        rollout(wl[i], range_stats, rng);
       }
     }
 
@@ -156,7 +150,7 @@ class deep_tree_simulator {
             if (child.can_expand()) {
               non_terminals.push_back(&child);
             } else {
-              Game g = child.get_game(); 
+              const Game& g = child.get_game();
               child.set_mean(g.get_cumulative_reward());
               child.set_sd(0);
             }
@@ -27,6 +27,11 @@ struct config {
   double root_sd;
 };
 
+bool operator==(const config& lhs, const config& rhs) {
+  return lhs.root_children == rhs.root_children && lhs.root_mean == rhs.root_mean
+    && lhs.root_sd == rhs.root_sd;
+}
+
 /**
  * Parses a .toml configuration file for a generic game.
  * Creates a config object and sets its fields based on the
@@ -50,7 +55,8 @@ class game {
     using move_type = int;
   private:
     /* Members */
-    config cfg_;
+    // interned (see intern in util.hpp) so that states share a single config
+    const config* cfg_;
     double mean_;
     double sd_;
     int success_count_;
@@ -176,14 +182,14 @@ class game {
       std::string varphi_model_path = "../models/varphi_model.pt",
       std::string delta_model_path = "../models/delta_model.pt"
     )
-      : cfg_(cfg),
-        mean_(cfg_.root_mean),
-        sd_(cfg_.root_sd),
+      : cfg_(intern(cfg)),
+        mean_(cfg_->root_mean),
+        sd_(cfg_->root_sd),
         success_count_(0),
         num_moves_made_(0),
         num_siblings_(0),
         delta_module_(torch::jit::load(delta_model_path)),
-        num_children_(cfg_.root_children),
+        num_children_(cfg_->root_children),
         available_moves_(find_available_moves()),
         cumulative_reward_(find_current_reward()),
         sd_module_(torch::jit::load(sd_model_path)),
@@ -248,11 +254,11 @@ class game {
     }
 
     /**
-     * Getter for vector of available moves of move_type. Returns a copy
+     * Getter for vector of available moves of move_type
      *
-     * @return a vector of available moves from this game state
+     * @return a const reference to the vector of available moves from this game state
      */
-    std::vector<move_type> get_available_moves() const noexcept {
+    const std::vector<move_type>& get_available_moves() const noexcept {
       return available_moves_;
     }
 
@@ -284,6 +290,16 @@ class game {
     game make_move(move_type move) const {
       return game(*this, move);
     }
+
+    /**
+     * Makes a move in the current game, replacing this state with the
+     * resulting one
+     *
+     * @param move the move to be made from this state
+     */
+    void apply(move_type move) {
+      *this = game(*this, move);
+    }
 };
 
 }
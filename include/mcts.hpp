@@ -1,76 +1,229 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <chrono>
 #include <cmath>
-#include <deque>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "playout_state.hpp"
+#include "thread_pool.hpp"
 #include "util.hpp"
 
-static std::size_t node_id = 0;
-
 namespace mcts
 {
 
 /**
- * This class is used to get at private members and non-exposed
- * members of the node class. This is useful for testing
+ * nodes refer to each other (and to their game states) by 32 bit indices into
+ * the arena of the tree which holds them
+ */
+using index_type = std::uint32_t;
+
+/**
+ * the index used to mean "no node", e.g. as the parent of the root
+ */
+constexpr index_type no_index = std::numeric_limits<index_type>::max();
+
+/**
+ * A growable array whose elements never move, so that threads may read
+ * elements while others allocate more. Elements live in fixed size chunks
+ * found through a table of chunk pointers which is allocated up front; a run
+ * of elements allocated together is always kept within one chunk, so runs are
+ * contiguous. Allocation takes a lock, while reading an element only takes an
+ * acquire load of its chunk pointer. Every element of a chunk is default
+ * constructed when the chunk is made.
  */
-template <class Node>
-class node_exposer {
+template <class T, unsigned ChunkBits, std::size_t MaxChunks = std::size_t(1) << 16>
+class arena {
   private:
-    Node& node_;
+    static constexpr index_type chunk_size = index_type(1) << ChunkBits;
+    static constexpr index_type chunk_mask = chunk_size - 1;
+    std::unique_ptr<std::atomic<T*>[]> chunks_;
+    std::atomic<index_type> size_;
+    std::mutex mutex_;
   public:
+    arena()
+      : chunks_(new std::atomic<T*>[MaxChunks]),
+        size_(0)
+    {
+      for (std::size_t i = 0; i < MaxChunks; i++) {
+        chunks_[i].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    ~arena() {
+      for (std::size_t i = 0; i < MaxChunks && chunks_[i].load(std::memory_order_relaxed); i++) {
+        delete[] chunks_[i].load(std::memory_order_relaxed);
+      }
+    }
+
     /**
-     * node_exposer constructor. wraps a reference to a node
+     * allocates a contiguous run of elements. If the run doesn't fit in what
+     * is left of the current chunk, that space is skipped and the run starts
+     * a new chunk.
      *
-     * @param node a mutable reference to a node
+     * @param n the number of elements, at most the chunk size
+     * @return the index of the first element of the run
      */
-    node_exposer(Node& node)
-     : node_(node)
-    {} 
+    index_type allocate(index_type n) {
+      assert(n <= chunk_size);
+      std::lock_guard<std::mutex> guard(mutex_);
+      index_type first = size_.load(std::memory_order_relaxed);
+      if ((first & chunk_mask) + n > chunk_size) {
+        first = (first | chunk_mask) + 1;
+      }
+      std::size_t chunk = first >> ChunkBits;
+      assert(chunk < MaxChunks);
+      if (!chunks_[chunk].load(std::memory_order_relaxed)) {
+        chunks_[chunk].store(new T[chunk_size], std::memory_order_release);
+      }
+      size_.store(first + n, std::memory_order_relaxed);
+      return first;
+    }
+
+    T& operator[](index_type i) noexcept {
+      return chunks_[i >> ChunkBits].load(std::memory_order_acquire)[i & chunk_mask];
+    }
+
+    const T& operator[](index_type i) const noexcept {
+      return chunks_[i >> ChunkBits].load(std::memory_order_acquire)[i & chunk_mask];
+    }
 
     /**
-     * a getter for a non-const reference the node's children vector
+     * gets the number of element slots handed out so far, including any
+     * skipped at the ends of chunks
      *
-     * @return a reference to the wrapped node's children vector
+     * @return the size of the arena
      */
-    std::vector<Node>& get_children() {
-      return node_.get_children();
+    std::size_t size() const noexcept {
+      return size_.load(std::memory_order_relaxed);
     }
-}; 
+};
+
+/**
+ * adds to an atomic double (fetch_add only covers doubles from C++20 on)
+ *
+ * @param x the value to add to
+ * @param delta the amount to add
+ */
+inline void atomic_add(std::atomic<double>& x, double delta) noexcept {
+  double cur = x.load(std::memory_order_relaxed);
+  while (!x.compare_exchange_weak(cur, cur + delta, std::memory_order_relaxed)) {}
+}
+
+/**
+ * detects whether a game provides hash(), which trees use to find game states
+ * reached by more than one sequence of moves
+ */
+template <class Game, class = void>
+struct has_hash : std::false_type {};
 
+template <class Game>
+struct has_hash<Game, std::void_t<decltype(std::declval<const Game&>().hash())>>
+  : std::true_type {};
+
+template <class Game>
+class tree;
+
+/**
+ * The statistics and links of a single search tree node. Nodes don't own
+ * anything; they live in a tree's arena and refer to their parent, their
+ * children and their game state (if they keep one, see tree) by index. A
+ * node's children are allocated as one contiguous block when the node is
+ * first expanded, sized to its number of available moves, and are then
+ * filled in one at a time in move order. The number of children so far is
+ * therefore also a cursor into the node's move list, pointing at the next
+ * move to expand.
+ *
+ * The visit count, the q total and the number of children are atomic so that
+ * several threads can search one tree. Everything else is written once, when
+ * the node is filled in, before the parent's child count is raised to
+ * publish it.
+ *
+ * When a tree merges transpositions, a child slot whose state is already in
+ * the tree becomes a link to the node holding that state (see get_link), and
+ * only the linked node is used for statistics.
+ *
+ * A node is solved once the best final score reachable from it is known
+ * exactly: terminal nodes are solved when they are made, and a node whose
+ * children are all expanded and solved is solved with the best of their
+ * values (see tree::try_solve). The value is written before the flag is
+ * raised, so whoever sees the flag sees the value.
+ */
 template <class Game>
 class node {
   public:
     using move_type = typename Game::move_type;
     using state_type = Game;
   private:
-    friend node_exposer<node>;
-    std::size_t n_;
-    double q_total_;
-    node* parent_;
-    std::vector<node> children_;
-    Game game_;
-    std::deque<move_type> unused_moves_;
-    bool is_terminal_;
+    friend tree<Game>;
+    std::atomic<std::size_t> n_;
+    std::atomic<double> q_total_;
+    index_type parent_;
+    index_type state_;
+    index_type first_child_;
+    std::atomic<index_type> num_children_;
+    index_type num_moves_;
+    index_type link_;
+    int depth_;
     move_type move_;
-    std::size_t node_id_;
-  public:
-    node(Game game, move_type move = move_type{}, node* parent = nullptr)
-     : n_(0),
-       q_total_(0),
-       parent_(parent),
-       game_(game),
-       move_(move),
-       node_id_(node_id++)
-    {
-      std::vector<move_type> avail_moves = game_.get_available_moves();
-      unused_moves_.insert(unused_moves_.end(), avail_moves.begin(), avail_moves.end()); 
-      is_terminal_ = avail_moves.empty();
+    bool is_terminal_;
+    std::atomic<bool> solved_;
+    std::atomic<double> value_;
+    // held while a thread adds a child to this node
+    std::atomic_flag expanding_ = ATOMIC_FLAG_INIT;
+
+    /**
+     * fills in an empty slot
+     *
+     * @param parent the index of the parent node, or no_index for a root
+     * @param state the index of the node's game state in the tree, or no_index
+     * if the node doesn't keep its state
+     * @param depth the number of moves from the root to this node
+     * @param move the move taken from the parent to get here
+     * @param num_moves the number of moves available in the node's game state
+     * @param reward the cumulative reward of the node's game state, which is
+     * its value if it is terminal
+     */
+    void init(index_type parent, index_type state, int depth, move_type move, index_type num_moves,
+              double reward) noexcept {
+      n_.store(0, std::memory_order_relaxed);
+      q_total_.store(0, std::memory_order_relaxed);
+      parent_ = parent;
+      state_ = state;
+      first_child_ = no_index;
+      num_children_.store(0, std::memory_order_relaxed);
+      num_moves_ = num_moves;
+      link_ = no_index;
+      depth_ = depth;
+      move_ = move;
+      is_terminal_ = num_moves == 0;
+      value_.store(reward, std::memory_order_relaxed);
+      solved_.store(is_terminal_, std::memory_order_relaxed);
     }
+  public:
+    /**
+     * constructs an empty slot in a block of children, which is filled in
+     * when the child is expanded
+     */
+    node() = default;
 
     /**
      * getter for the visit count of this node
@@ -78,7 +231,7 @@ class node {
      * @return the visit count of the node
      */
     std::size_t get_n() const noexcept {
-      return n_;
+      return n_.load(std::memory_order_relaxed);
     }
 
     /**
@@ -87,15 +240,15 @@ class node {
      * @return the sum of q values
      */
     double get_q_total() const noexcept {
-      return q_total_;
+      return q_total_.load(std::memory_order_relaxed);
     }
 
     /**
      * getter for the parent of this node
      *
-     * @return a pointer to the parent node
+     * @return the index of the parent node, or no_index for the root
      */
-    node* get_parent() const noexcept {
+    index_type get_parent() const noexcept {
       return parent_;
     }
 
@@ -109,34 +262,23 @@ class node {
       return is_terminal_;
     }
 
-
     /**
-     * getter for finding the total, cumulative reward of a game
+     * whether the best final score reachable from this node is known
      *
-     * @return the total reward
+     * @return true if the node is terminal or all of its children are solved
      */
-    double get_reward() const noexcept {
-      return game_.get_cumulative_reward(); 
+    bool is_solved() const noexcept {
+      return solved_.load(std::memory_order_acquire);
     }
 
     /**
-     * gets a copy of the wrapped state (the game)
+     * getter for the best final score reachable from this node, which is
+     * only meaningful once it is solved
      *
-     * @return copy of the wrapped state
+     * @return the value of the node
      */
-    state_type get_state() const noexcept {
-      return game_;
-    }
-
-    /**
-     * Gets the number of moves that have occurred in the
-     * wrapped game instance. This shnould correspond to
-     * the depth this node is in a tree search tree.
-     *
-     * @return the number of moves which occurred in the node's game
-     */
-    int get_depth() const noexcept {
-      return game_.get_num_moves_made();
+    double get_value() const noexcept {
+      return value_.load(std::memory_order_relaxed);
     }
 
     /**
@@ -151,33 +293,44 @@ class node {
     }
 
     /**
-     * Loops up a chain of nodes in the tree and appends the move
-     * of each state (see get_move above) until arriving at a root.
-     * This corresponds to the sequence of moves taken in the game
-     * to reach this wrapped game state.
+     * gets the index of the first child. the children of a node are
+     * contiguous, so the rest follow it.
      *
-     * @return the sequence of moves taken in the game to arrive
-     * at the wrapped game state
+     * @return the index of the first child, or no_index if the node
+     * hasn't been expanded
      */
-    std::vector<move_type> get_seq() const noexcept {
-      std::vector<move_type> seq;
-      const node* cur = this;
-      while (cur->get_parent()) {
-        seq.push_back(cur->get_move());
-        cur = cur->get_parent();
-      }
-      std::reverse(seq.begin(), seq.end());
-      return seq;
+    index_type get_first_child() const noexcept {
+      return first_child_;
+    }
+
+    /**
+     * gets the node this slot links to, if its state was already in the tree
+     * when it was expanded
+     *
+     * @return the index of the linked node, or no_index if this slot is a
+     * node in its own right
+     */
+    index_type get_link() const noexcept {
+      return link_;
+    }
+
+    /**
+     * gets the number of children expanded so far
+     *
+     * @return the number of children of this node
+     */
+    index_type get_num_children() const noexcept {
+      return num_children_.load(std::memory_order_acquire);
     }
 
     /**
-     * gets the node_id of this node. this is useful for generating
-     * dot files among other things.
+     * gets the number of moves available in this node's game state, which is
+     * the number of children it has once fully expanded
      *
-     * @return the id of this node (an integer)
+     * @return the number of available moves
      */
-    std::size_t get_node_id() const noexcept {
-      return node_id_;
+    index_type get_num_moves() const noexcept {
+      return num_moves_;
     }
 
     /**
@@ -186,64 +339,517 @@ class node {
      * @param n the new visit count
      */
     void set_n(std::size_t n) noexcept {
-      n_ = n;
+      n_.store(n, std::memory_order_relaxed);
     }
 
     /**
      * setter for the total q value of the node
      *
      * @param q_total the new total q value of this node
-     */ 
+     */
     void set_q_total(double q_total) noexcept {
-      q_total_ = q_total;
-    } 
+      q_total_.store(q_total, std::memory_order_relaxed);
+    }
+
+    /**
+     * counts a visit which hasn't been backed up yet and takes a virtual
+     * loss off the q total until it is (see add_reward)
+     *
+     * @param virtual_loss the reward to take off
+     */
+    void add_virtual_loss(double virtual_loss) noexcept {
+      n_.fetch_add(1, std::memory_order_relaxed);
+      atomic_add(q_total_, -virtual_loss);
+    }
+
+    /**
+     * takes back a visit counted by add_virtual_loss which won't be backed up
+     *
+     * @param virtual_loss the virtual loss taken off for the visit
+     */
+    void remove_virtual_loss(double virtual_loss) noexcept {
+      n_.fetch_sub(1, std::memory_order_relaxed);
+      atomic_add(q_total_, virtual_loss);
+    }
+
+    /**
+     * backs up the reward of a visit counted by add_virtual_loss
+     *
+     * @param delta the reward of the visit
+     * @param virtual_loss the virtual loss taken off for the visit
+     */
+    void add_reward(double delta, double virtual_loss) noexcept {
+      atomic_add(q_total_, delta + virtual_loss);
+    }
+
+    /**
+     * marks this node as solved
+     *
+     * @param value the best final score reachable from the node
+     */
+    void set_solved(double value) noexcept {
+      value_.store(value, std::memory_order_relaxed);
+      solved_.store(true, std::memory_order_release);
+    }
+};
+
+/**
+ * A search tree whose nodes are stored in an arena and linked by index, so
+ * walking down the tree touches compact blocks of node statistics rather
+ * than chasing pointers around the heap. Game states are kept apart from the
+ * nodes in an arena of their own. Nodes and states never move once made.
+ *
+ * By default every node keeps its game state. With a checkpoint interval of
+ * K > 1 only nodes at depths which are multiples of K keep theirs, and with
+ * an interval of 0 only the root does. The state of any other node is rebuilt
+ * by replaying the moves down to it from its closest ancestor with a state,
+ * which trades some time for a tree many times larger in the same memory.
+ * This requires moves to be deterministic, i.e. make_move and apply must
+ * always give the same state for the same move.
+ *
+ * A tree may also merge transpositions, i.e. game states reached by more
+ * than one sequence of moves, which turns it into a DAG. States are looked up
+ * by their hash and cumulative reward in a transposition table, and a child
+ * whose state is already in the tree links to the node holding it instead of
+ * getting a node of its own. Such a node's parent, depth and sequence are
+ * those of the path it was first reached by, which leads to the same state.
+ * Moves must never lead back to an earlier state.
+ *
+ * Any number of threads may expand, read and update the statistics of the
+ * tree at once. Expanding a node holds a lock on that node only, plus a lock
+ * on one shard of the transposition table while looking the new state up.
+ */
+template <class Game>
+class tree {
+  public:
+    using node_type = node<Game>;
+    using move_type = typename Game::move_type;
+    using state_type = Game;
+  private:
+    // game states are told apart by hash and by cumulative reward, since the
+    // same board reached with a different score has a different value
+    using key_type = std::pair<std::uint64_t, double>;
+
+    struct key_hash {
+      std::size_t operator()(const key_type& key) const noexcept {
+        return key.first ^ std::hash<double>{}(key.second);
+      }
+    };
+
+    static constexpr std::size_t num_shards = 64;
+
+    struct shard {
+      std::mutex mutex_;
+      std::unordered_map<key_type, index_type, key_hash> nodes_;
+    };
+
+    arena<node_type, 16> nodes_;
+    arena<std::optional<Game>, 10> states_;
+    std::size_t checkpoint_interval_;
+    // the transposition table, or nullptr if the tree doesn't merge them
+    std::unique_ptr<shard[]> table_;
+    std::atomic<std::size_t> num_nodes_;
+    std::atomic<std::size_t> num_transpositions_;
+
+    static key_type key_of(const Game& state) {
+      if constexpr (has_hash<Game>::value) {
+        return {state.hash(), state.get_cumulative_reward()};
+      } else {
+        // unreachable, since the constructor rejects transpositions without a hash
+        assert(!"merging transpositions needs Game::hash()");
+        return {0, 0};
+      }
+    }
+
+    /**
+     * fills in the slot of a new child, keeping its state if it is at a
+     * checkpoint depth
+     */
+    void init_child(index_type child, index_type v, int depth, move_type move, const Game& state) {
+      index_type child_state = no_index;
+      if (checkpoint_interval_ != 0 && depth % checkpoint_interval_ == 0) {
+        child_state = states_.allocate(1);
+        states_[child_state].emplace(state);
+      }
+      nodes_[child].init(v, child_state, depth, move, state.get_available_moves().size(),
+                         state.get_cumulative_reward());
+      num_nodes_++;
+    }
+
+    /**
+     * copies the statistics and the expanded children of a node of another
+     * tree into a node of this one, and then does the same for each child
+     *
+     * @param other the tree to copy from
+     * @param from the index of the node in other
+     * @param to the index of the node in this tree, already filled in
+     * @param state the game state of the node if this tree merges
+     * transpositions, which is advanced and restored while copying children
+     * @param copied the node in this tree of each node of other copied so far,
+     * which is only kept if this tree merges transpositions
+     */
+    void copy_subtree(const tree& other, index_type from, index_type to, Game& state,
+                      std::unordered_map<index_type, index_type>& copied) {
+      const node_type& src = other.nodes_[from];
+      node_type& dst = nodes_[to];
+      dst.n_.store(src.get_n(), std::memory_order_relaxed);
+      dst.q_total_.store(src.get_q_total(), std::memory_order_relaxed);
+      if (src.is_solved()) {
+        dst.set_solved(src.get_value());
+      }
+      index_type num_children = src.get_num_children();
+      if (num_children == 0) {
+        return;
+      }
+
+      dst.first_child_ = nodes_.allocate(dst.num_moves_);
+      for (index_type i = 0; i < num_children; i++) {
+        index_type slot = dst.first_child_ + i;
+        const node_type& src_slot = other.nodes_[src.first_child_ + i];
+        index_type src_child = other.get_child(from, i);
+        const node_type& src_node = other.nodes_[src_child];
+        auto found = table_ ? copied.find(src_child) : copied.end();
+        if (found != copied.end()) {
+          nodes_[slot].init(to, no_index, dst.depth_ + 1, src_slot.move_, src_node.num_moves_, 0);
+          nodes_[slot].link_ = found->second;
+          num_transpositions_++;
+          continue;
+        }
+
+        index_type child_state = no_index;
+        if (src_node.state_ != no_index) {
+          child_state = states_.allocate(1);
+          states_[child_state].emplace(*other.states_[src_node.state_]);
+        }
+        nodes_[slot].init(to, child_state, dst.depth_ + 1, src_slot.move_, src_node.num_moves_, 0);
+        num_nodes_++;
+        if (table_) {
+          Game child(state);
+          child.apply(src_slot.move_);
+          key_type key = key_of(child);
+          table_[key_hash{}(key) % num_shards].nodes_.emplace(key, slot);
+          copied.emplace(src_child, slot);
+          copy_subtree(other, src_child, slot, child, copied);
+        } else {
+          copy_subtree(other, src_child, slot, state, copied);
+        }
+      }
+      dst.num_children_.store(num_children, std::memory_order_relaxed);
+    }
+  public:
+    /**
+     * tree constructor. makes a tree holding only a root node
+     *
+     * @param root the game state of the root
+     * @param checkpoint_interval the number of plies between nodes which keep
+     * their game state, or 0 to only keep the root's
+     * @param merge_transpositions whether children whose state is already in
+     * the tree link to it rather than get a node of their own. needs
+     * Game::hash(), and throws std::invalid_argument for games without one
+     */
+    explicit tree(const Game& root, std::size_t checkpoint_interval = 1, bool merge_transpositions = false)
+      : checkpoint_interval_(checkpoint_interval),
+        num_nodes_(1),
+        num_transpositions_(0)
+    {
+      if (merge_transpositions && !has_hash<Game>::value) {
+        throw std::invalid_argument("merging transpositions needs Game::hash()");
+      }
+      states_[states_.allocate(1)].emplace(root);
+      nodes_[nodes_.allocate(1)].init(no_index, 0, 0, move_type{}, root.get_available_moves().size(),
+                                      root.get_cumulative_reward());
+      if (merge_transpositions) {
+        table_.reset(new shard[num_shards]);
+        key_type key = key_of(root);
+        table_[key_hash{}(key) % num_shards].nodes_.emplace(key, get_root());
+      }
+    }
+
+    /**
+     * makes a tree out of the subtree of another tree rooted at one of its
+     * nodes, keeping the statistics of every node in it. the rest of the
+     * other tree is left behind, so this is how a tree is re-rooted at a
+     * child while freeing its siblings' subtrees. must not run while other
+     * is being searched.
+     *
+     * @param other the tree to copy from
+     * @param v the index in other of the node to make the root
+     */
+    tree(const tree& other, index_type v)
+      : checkpoint_interval_(other.checkpoint_interval_),
+        num_nodes_(1),
+        num_transpositions_(0)
+    {
+      Game root(*other.states_[0]);
+      other.load_state(v, root);
+      states_[states_.allocate(1)].emplace(root);
+      nodes_[nodes_.allocate(1)].init(no_index, 0, 0, move_type{}, other.nodes_[v].num_moves_,
+                                      root.get_cumulative_reward());
+      std::unordered_map<index_type, index_type> copied;
+      if (other.table_) {
+        table_.reset(new shard[num_shards]);
+        key_type key = key_of(root);
+        table_[key_hash{}(key) % num_shards].nodes_.emplace(key, get_root());
+        copied.emplace(v, get_root());
+      }
+      copy_subtree(other, v, get_root(), root, copied);
+    }
+
+    /**
+     * gets the index of the root node
+     *
+     * @return the index of the root
+     */
+    index_type get_root() const noexcept {
+      return 0;
+    }
+
+    node_type& operator[](index_type v) noexcept {
+      return nodes_[v];
+    }
+
+    const node_type& operator[](index_type v) const noexcept {
+      return nodes_[v];
+    }
+
+    /**
+     * gets the number of node slots in the arena, which includes slots for
+     * children which have not been expanded yet
+     *
+     * @return the size of the arena
+     */
+    std::size_t size() const noexcept {
+      return nodes_.size();
+    }
+
+    /**
+     * gets the number of nodes in the tree, not counting child slots which
+     * link to other nodes
+     *
+     * @return the number of nodes
+     */
+    std::size_t get_num_nodes() const noexcept {
+      return num_nodes_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * gets the number of children which were found to be in the tree already
+     * and link to the node holding their state
+     *
+     * @return the number of merged transpositions
+     */
+    std::size_t get_num_transpositions() const noexcept {
+      return num_transpositions_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * gets a child of a node, following the link if the child's state was
+     * already in the tree
+     *
+     * @param v the index of the node
+     * @param i the index of the child among v's children, which must have
+     * been expanded
+     * @return the index of the node holding the child's state
+     */
+    index_type get_child(index_type v, index_type i) const noexcept {
+      index_type c = nodes_[v].first_child_ + i;
+      return nodes_[c].link_ == no_index ? c : nodes_[c].link_;
+    }
+
+    /**
+     * gets the number of game states kept by the tree
+     *
+     * @return the number of nodes which keep their state
+     */
+    std::size_t get_num_states() const noexcept {
+      return states_.size();
+    }
+
+    /**
+     * rebuilds the game state of a node by copying the state of its closest
+     * ancestor (or itself) which keeps one and replaying the moves from there
+     *
+     * @param v the index of the node
+     * @param state set to the node's game state
+     */
+    void load_state(index_type v, Game& state) const {
+      if (nodes_[v].state_ != no_index) {
+        state = *states_[nodes_[v].state_];
+      } else {
+        load_state(nodes_[v].parent_, state);
+        state.apply(nodes_[v].move_);
+      }
+    }
+
+    /**
+     * Gets the number of moves from the root to a node, i.e. the depth the
+     * node is at in the search tree.
+     *
+     * @param v the index of the node
+     * @return the depth of the node
+     */
+    int get_depth(index_type v) const noexcept {
+      return nodes_[v].depth_;
+    }
+
+    /**
+     * Walks up the tree from a node to the root, collecting the move of each
+     * node on the way (see node::get_move). This corresponds to the sequence
+     * of moves taken in the game to reach the node's game state.
+     *
+     * @param v the index of the node
+     * @return the sequence of moves taken in the game to arrive
+     * at the node's game state
+     */
+    std::vector<move_type> get_seq(index_type v) const {
+      std::vector<move_type> seq;
+      for (; nodes_[v].parent_ != no_index; v = nodes_[v].parent_) {
+        seq.push_back(nodes_[v].move_);
+      }
+      std::reverse(seq.begin(), seq.end());
+      return seq;
+    }
 
     /**
-     * appends a child node to this node by taking
-     * an unused move from the deque and making a new
-     * game state from this node. the new game state is wrapped
-     * in a node and appended as a child.
+     * appends a child to a node by taking the next unexpanded move from the
+     * node's game state. The first expansion of a node allocates the block
+     * for all of its children. If another thread is expanding the node this
+     * gives up rather than wait.
      *
-     * @return the newly appended node or a nullptr if nothing was
-     * appended.
+     * @param v the index of the node to expand
+     * @param state scratch space which, if a child is made, is set to the game
+     * state of the new child
+     * @param linked set to whether the new child is a link to a node already
+     * in the tree rather than a node of its own
+     * @return the index of the new child (or of the node it links to), or
+     * no_index if every move of v has already been expanded or another thread
+     * holds v
      */
-    node* expand() {
-      if (unused_moves_.empty()) {
-        if (children_.empty()) {
-          is_terminal_ = true;
+    index_type expand(index_type v, Game& state, bool& linked) {
+      linked = false;
+      node_type& parent = nodes_[v];
+      if (parent.expanding_.test_and_set(std::memory_order_acquire)) {
+        return no_index;
+      }
+      index_type num_children = parent.num_children_.load(std::memory_order_relaxed);
+      if (num_children == parent.num_moves_) {
+        parent.expanding_.clear(std::memory_order_release);
+        return no_index;
+      }
+      if (num_children == 0) {
+        parent.first_child_ = nodes_.allocate(parent.num_moves_);
+      }
+
+      load_state(v, state);
+      move_type move = state.get_available_moves()[num_children];
+      index_type child = parent.first_child_ + num_children;
+      int depth = parent.depth_ + 1;
+      state.apply(move);
+      index_type result = child;
+      if (table_) {
+        // the child is filled in before it goes in the table, so that whoever
+        // finds it there finds it complete
+        key_type key = key_of(state);
+        shard& sh = table_[key_hash{}(key) % num_shards];
+        std::lock_guard<std::mutex> guard(sh.mutex_);
+        auto found = sh.nodes_.find(key);
+        if (found != sh.nodes_.end()) {
+          result = found->second;
+          nodes_[child].init(v, no_index, depth, move, nodes_[result].num_moves_, 0);
+          nodes_[child].link_ = result;
+          linked = true;
+          num_transpositions_++;
+        } else {
+          init_child(child, v, depth, move, state);
+          sh.nodes_.emplace(key, child);
         }
-        return nullptr;
+      } else {
+        init_child(child, v, depth, move, state);
       }
-      move_type move = unused_moves_.front();
-      unused_moves_.pop_front();
+      parent.num_children_.store(num_children + 1, std::memory_order_release);
+      parent.expanding_.clear(std::memory_order_release);
+      return result;
+    }
 
-      Game to_append = game_.make_move(move);
-      children_.push_back(node(to_append, move, this));
-      return &(children_.back());
+    /**
+     * appends a child to a node as above
+     *
+     * @param v the index of the node to expand
+     * @return the index of the new child, or no_index if every move of v has
+     * already been expanded
+     */
+    index_type expand(index_type v) {
+      Game state(*states_[0]);
+      bool linked;
+      return expand(v, state, linked);
+    }
+
+    /**
+     * solves a node if every move of it has been expanded into a solved child,
+     * giving it the best of their values
+     *
+     * @param v the index of the node
+     * @return true if the node is solved, whether by this call or before
+     */
+    bool try_solve(index_type v) {
+      node_type& nd = nodes_[v];
+      if (nd.is_solved()) {
+        return true;
+      }
+      index_type num_children = nd.get_num_children();
+      if (num_children < nd.num_moves_) {
+        return false;
+      }
+      double value = -std::numeric_limits<double>::max();
+      for (index_type i = 0; i < num_children; i++) {
+        const node_type& child = nodes_[get_child(v, i)];
+        if (!child.is_solved()) {
+          return false;
+        }
+        value = std::max(value, child.get_value());
+      }
+      nd.set_solved(value);
+      return true;
     }
 
     /**
-     * Returns the best child of the node according to UCT.
+     * Returns the best child of a node according to UCT.
      * If a child is unvisited, n=0 and UCT score is infinite,
-     * so go ahead and return it. Otherwise return the child 
-     * which maximizes UCT.
+     * so go ahead and return it. Otherwise return the child
+     * which maximizes UCT. Solved children are skipped, since
+     * searching them again can't teach anything new.
      *
-     * @return a pointer to the child node which maximizes UCT
+     * @param v the index of the node
+     * @return the index of the unsolved child which maximizes
+     * UCT, or no_index if every expanded child is solved
      */
-    node* best_child() {
-      node* best = nullptr;
+    index_type best_child(index_type v) const {
+      const node_type& parent = nodes_[v];
+      // the child count is read first, since it publishes first_child_
+      index_type num_children = parent.get_num_children();
+      if (num_children == 0) {
+        return no_index;
+      }
+      index_type first = parent.first_child_;
+      index_type last = first + num_children;
+      double log_n = std::log(parent.get_n());
+      index_type best = no_index;
       double max_uct = -std::numeric_limits<double>::max();
-      for (auto& child : children_) {
-        double n = child.get_n();
+      for (index_type slot = first; slot < last; slot++) {
+        index_type c = nodes_[slot].link_ == no_index ? slot : nodes_[slot].link_;
+        if (nodes_[c].is_solved()) {
+          continue;
+        }
+        double n = nodes_[c].get_n();
         if (!n) {
-          return &child;
+          return c;
         }
-        double Q = child.get_q_total();
+        double Q = nodes_[c].get_q_total();
         constexpr double C = 1;
 
-        double uct_score = Q / n + C * std::sqrt(2 * std::log(n_) / n);
+        double uct_score = Q / n + C * std::sqrt(2 * log_n / n);
         if (uct_score > max_uct) {
-          best = &child;
+          best = c;
           max_uct = uct_score;
         }
       }
@@ -265,127 +871,725 @@ class uct_exposer {
     {}
 };
 
-template <class Node>
+/**
+ * how the threads of a uct search share the work
+ */
+enum class parallelism {
+  // every thread searches the one tree
+  tree,
+  // every thread grows a tree of its own from the root, and the statistics
+  // of the roots' children are merged
+  root
+};
+
+/**
+ * settings for a uct search
+ */
+struct uct_config {
+  // the number of iterations a search runs for, over all threads, or 0 for
+  // no limit, in which case time_limit or uct::stop() must end it
+  std::size_t num_iterations = 1e5;
+  // the number of seconds of wall-clock time a search may take, or 0 for no
+  // limit. the search ends at whichever limit it reaches first
+  double time_limit = 0;
+  // the number of plies between tree nodes which keep their game state, or 0
+  // to only keep the root's (see tree)
+  std::size_t checkpoint_interval = 1;
+  // the number of threads searching, at least 1
+  std::size_t num_threads = 1;
+  // the reward taken off every node on a path while an iteration through it
+  // is in flight, which steers concurrent iterations onto different paths
+  double virtual_loss = 1;
+  parallelism mode = parallelism::tree;
+  // with root parallelism, the number of iterations each tree runs between
+  // sharing root statistics with the others, or 0 to only merge at the end
+  std::size_t sync_interval = 0;
+  // the number of playouts each searching thread runs at once from every
+  // leaf, on a pool of threads of its own, backing up their mean reward. at
+  // least 1
+  std::size_t leaf_playouts = 1;
+  // whether to merge game states reached by different move orders into one
+  // node (see tree). needs Game::hash(), and uct throws std::invalid_argument
+  // for games without one
+  bool transpositions = false;
+};
+
+/**
+ * a snapshot of a uct search (see uct::get_status)
+ */
+template <class Move>
+struct search_status {
+  // the number of iterations run by the current or last search
+  std::size_t num_iterations;
+  // the number of seconds the current or last search has taken
+  double seconds;
+  double high_score;
+  // the moves of the highest scoring game seen, from the original root
+  std::vector<Move> best_seq;
+  // the move and visit count of each root child expanded so far
+  std::vector<std::pair<Move, std::size_t>> root_visits;
+};
+
+/**
+ * UCT on one or more threads.
+ *
+ * With tree parallelism every thread runs whole iterations against the same
+ * tree: selection counts a visit and applies a virtual loss to each node on
+ * its path straight away, so that the other threads see those nodes as less
+ * attractive, and backup swaps the virtual loss for the real reward.
+ *
+ * With root parallelism every thread grows its own tree from the root, so the
+ * threads share nothing but the iteration counter and the best sequence. At
+ * each sync point every tree's root children are given the ensemble's mean
+ * statistics, and at the end the sums over the ensemble are written into the
+ * root children of the first tree, which get_tree() returns. Children are
+ * matched up by move index, which is the same in every tree.
+ *
+ * With more than one leaf playout, each searching thread evaluates a leaf by
+ * playing it out that many times at once on a thread pool, which uses spare
+ * cores during the simulations when playouts are expensive. This combines
+ * with either kind of parallelism.
+ *
+ * A search ends after a number of iterations, after a wall-clock time limit
+ * or when stop() is called, whichever comes first, and get_status() may be
+ * polled from any thread while it runs. A progress callback may also be set,
+ * which is called on the thread running the search.
+ *
+ * Each iteration backs up along the path it selected, which in a tree that
+ * merges transpositions need not follow the parent links.
+ *
+ * Backup also solves the nodes on the path whose children have all been
+ * solved (see node::is_solved), and selection never descends into a solved
+ * node, so no iteration is spent replaying a subtree whose best score is
+ * already known. A tree's search ends early once its root is solved.
+ *
+ * Each thread keeps its own scratch state and random number generator, as
+ * does each leaf playout. The game's moves and playouts must be safe to run
+ * on separate states at once.
+ */
+template <class Game>
 class uct {
   public:
+    using tree_type = tree<Game>;
+    using move_type = typename Game::move_type;
+    using status_type = search_status<move_type>;
   private:
-    Node root_;
-    double high_score_;
-    std::vector<typename Node::move_type> best_seq_; 
-    std::size_t num_iterations_;
-    int max_constructed_depth_;
-    std::size_t total_nodes_;
+    using clock = std::chrono::steady_clock;
+
+    // the scratch space of one of the playouts run at once from a leaf
+    struct leaf_playout {
+      Game playout_;
+      std::vector<move_type> random_seq_;
+      std::minstd_rand rng_;
+      double reward_;
+    };
+
+    // the scratch space of one searching thread. playout_ is reused for
+    // expansions and by default_policy so that playouts don't allocate, and
+    // loaded_ is the node whose state it holds, if any.
+    struct worker {
+      tree_type* tree_;
+      Game playout_;
+      index_type loaded_;
+      std::vector<move_type> random_seq_;
+      std::minstd_rand rng_;
+      // the nodes selected by the current iteration, from the root down
+      std::vector<index_type> path_;
+      // the playouts run at once from a leaf, if there is more than one
+      std::vector<leaf_playout> leaf_playouts_;
+      std::unique_ptr<thread_pool> leaf_pool_;
+    };
+
+    uct_config cfg_;
+    std::vector<std::unique_ptr<tree_type>> trees_;
+    // held while get_status reads the trees and while advance replaces them
+    std::mutex trees_mutex_;
+    std::atomic<double> high_score_;
+    std::vector<move_type> best_seq_;
+    std::mutex best_mutex_;
+    std::atomic<int> max_constructed_depth_;
+    std::atomic<std::size_t> num_expansions_;
+    std::vector<worker> workers_;
+    // the moves played so far by play(), which lead to the root
+    std::vector<move_type> played_;
+    // the progress of the current or last search
+    std::atomic<bool> searching_;
+    std::atomic<bool> stop_requested_;
+    std::atomic<std::size_t> num_iterations_run_;
+    std::atomic<clock::time_point> start_;
+    std::atomic<clock::time_point> end_;
+    std::function<void(const status_type&)> on_progress_;
+    double progress_interval_;
     friend uct_exposer<uct>;
+
+    static const uct_config& check(const uct_config& cfg) {
+      if (cfg.num_threads == 0) {
+        throw std::invalid_argument("uct needs at least one thread");
+      }
+      if (cfg.leaf_playouts == 0) {
+        throw std::invalid_argument("uct needs at least one playout per leaf");
+      }
+      return cfg;
+    }
   public:
-    uct(Node root, std::size_t num_iterations = 1e5)
-     : root_(root), 
+    /**
+     * uct constructor. throws std::invalid_argument if the number of threads
+     * or of leaf playouts is 0, or if transpositions are asked for in a game
+     * without a hash
+     *
+     * @param root the game state to search from
+     * @param cfg the settings of the search
+     */
+    uct(const Game& root, const uct_config& cfg)
+     : cfg_(check(cfg)),
        high_score_(std::numeric_limits<double>::min()),
-       num_iterations_(num_iterations),
        max_constructed_depth_(0),
-       total_nodes_(1)
+       num_expansions_(0),
+       searching_(false),
+       stop_requested_(false),
+       num_iterations_run_(0),
+       start_(clock::time_point()),
+       end_(clock::time_point()),
+       progress_interval_(0)
+    {
+      std::size_t num_trees = cfg_.mode == parallelism::root ? cfg_.num_threads : 1;
+      for (std::size_t i = 0; i < num_trees; i++) {
+        trees_.push_back(std::make_unique<tree_type>(root, cfg_.checkpoint_interval, cfg_.transpositions));
+      }
+      for (std::size_t i = 0; i < cfg_.num_threads; i++) {
+        tree_type* t = trees_[i % num_trees].get();
+        workers_.push_back(worker{t, root, no_index, {}, std::minstd_rand(std::rand()), {}, {}, nullptr});
+        if (cfg_.leaf_playouts > 1) {
+          for (std::size_t j = 0; j < cfg_.leaf_playouts; j++) {
+            workers_.back().leaf_playouts_.push_back(leaf_playout{root, {}, std::minstd_rand(std::rand()), 0});
+          }
+          workers_.back().leaf_pool_ = std::make_unique<thread_pool>(cfg_.leaf_playouts - 1);
+        }
+      }
+    }
+
+    /**
+     * uct constructor for a single threaded search with default settings
+     *
+     * @param root the game state to search from
+     * @param num_iterations the number of iterations search() runs for
+     */
+    explicit uct(const Game& root, std::size_t num_iterations = 1e5)
+     : uct(root, uct_config{num_iterations})
     {}
 
+    /**
+     * getter for the search tree. with root parallelism this is the first
+     * tree, which holds the merged root statistics once search() is done.
+     *
+     * @return a const reference to the search tree
+     */
+    const tree_type& get_tree() const noexcept {
+      return *trees_.front();
+    }
+
     /**
      * This finds the best descendant of a node according
      * to UCT. It recurses down the tree starting from v0
      * until it finds either a terminal node or a node which
      * may yet be expanded. It uses UCT to determine which
-     * child to pick at each level.
-     *
-     * @param v0 the node to start looking from
-     * @return a pointer to the "best" descendant node
-     */
-    Node* tree_policy(Node* v0) {
-      Node* cur = v0;
-      while (!cur->is_terminal()) {
-        Node* expanded = cur->expand();
-        if (expanded) {
-          total_nodes_++;
-          return expanded;
-        } else {
-          if (!cur->is_terminal()) {
-            cur = cur->best_child();
-          }
-        }
-      }
-      return cur;
+     * child to pick at each level. Every node on the way,
+     * including the one returned, gets a virtual loss which
+     * backup takes back.
+     *
+     * @param v0 the index of the node to start looking from
+     * @return the index of the "best" descendant node, or no_index
+     * if v0 is solved
+     */
+    index_type tree_policy(index_type v0) {
+      return tree_policy(v0, workers_.front());
     }
 
     /**
      * Takes random actions in a game starting from some
-     * initial state until the game ends.
-     * 
-     * @param the node to start taking random actions from
+     * initial state until the game ends. This goes through
+     * play_out, so games with their own playout kernel use it.
+     *
+     * @param v the index of the node to start taking random actions from
      * @return the reward after playing the game out randomly from
      * the initial state.
      */
-    double default_policy(Node* v) {
-      auto game = v->get_state();
-      auto moves = game.get_available_moves(); 
-      std::vector<typename Node::move_type> random_seq;
-      while (!moves.empty()) {
-        int random_idx = std::rand() % moves.size();
-        auto move = moves[random_idx];
-        game = game.make_move(move);
-        moves = game.get_available_moves();
-        random_seq.push_back(move);
-      }
-
-      double reward = game.get_cumulative_reward();
-      if (reward > high_score_) {
-        high_score_ = reward;
-        auto prior_seq = v->get_seq();
-        random_seq.insert(random_seq.begin(), prior_seq.begin(), prior_seq.end());
-        best_seq_ = random_seq;
-      }
-      return game.get_cumulative_reward();
-    } 
+    double default_policy(index_type v) {
+      return default_policy(v, workers_.front());
+    }
 
     /**
-     * Propagates visit counts and deltas (rewards) up
-     * the tree until the root.
+     * Propagates deltas (rewards) up the path which the last
+     * call to tree_policy selected, replacing the virtual losses
+     * it applied on the way down. The visits were counted by
+     * tree_policy.
      *
-     * @param v a pointer to the node to start backup from
+     * @param v the index of the node to start backup from, which
+     * is the node tree_policy returned
      * @param delta the reward encountered which we use to increment
      * Q values with.
      */
-    void backup(Node* v, double delta) {
-      while (v) {
-        v->set_n(v->get_n() + 1);
-        v->set_q_total(v->get_q_total() + delta);
-        v = v->get_parent();
+    void backup(index_type v, double delta) {
+      assert(!workers_.front().path_.empty() && workers_.front().path_.back() == v);
+      backup(workers_.front(), delta);
+    }
+
+    /**
+     * sets a function to call with the status of the search every so often
+     * while it runs. it is called on the thread running the search, between
+     * that thread's iterations.
+     *
+     * @param on_progress the function to call
+     * @param interval the least number of seconds between calls
+     */
+    void set_progress_callback(std::function<void(const status_type&)> on_progress, double interval) {
+      on_progress_ = std::move(on_progress);
+      progress_interval_ = interval;
+    }
+
+    /**
+     * asks the current search to end, which it does once each thread
+     * finishes its iteration. may be called from any thread. has no effect
+     * on searches started afterwards.
+     */
+    void stop() noexcept {
+      stop_requested_.store(true);
+    }
+
+    /**
+     * takes a snapshot of the current or last search. may be called from any
+     * thread, including while a search or play() runs. with root parallelism
+     * the root visits are summed over the trees while searching, and taken
+     * from the merged first tree afterwards.
+     *
+     * @return the status of the search
+     */
+    status_type get_status() {
+      status_type status;
+      status.num_iterations = num_iterations_run_.load();
+      bool searching = searching_.load();
+      clock::time_point end = searching ? clock::now() : end_.load();
+      status.seconds = std::chrono::duration<double>(end - start_.load()).count();
+      {
+        std::lock_guard<std::mutex> guard(best_mutex_);
+        status.high_score = high_score_;
+        status.best_seq = best_seq_;
+      }
+      std::lock_guard<std::mutex> guard(trees_mutex_);
+      std::size_t num_trees = searching ? trees_.size() : 1;
+      for (std::size_t k = 0; k < num_trees; k++) {
+        const tree_type& t = *trees_[k];
+        index_type root = t.get_root();
+        for (index_type i = 0; i < t[root].get_num_children(); i++) {
+          std::size_t n = t[t.get_child(root, i)].get_n();
+          if (i < status.root_visits.size()) {
+            status.root_visits[i].second += n;
+          } else {
+            status.root_visits.emplace_back(t[t[root].get_first_child() + i].get_move(), n);
+          }
+        }
       }
+      return status;
     }
 
     /**
-     * Primary driver for UCT in which we sequentially explore/expand,
-     * simulate, and backpropagate findings
+     * runs a search, like search() does, without printing anything
+     *
+     * @return the status at the end of the search
      */
-    void search() {
-      using clock = std::chrono::high_resolution_clock;
-      using duration = std::chrono::duration<float>;
+    status_type explore() {
       clock::time_point start = clock::now();
+      start_ = start;
+      num_iterations_run_ = 0;
+      num_expansions_ = 0;
+      stop_requested_ = false;
+      searching_ = true;
 
-      for (std::size_t i = 0; i < num_iterations_; i++) {
-        Node* v1 = tree_policy(&root_);
-        max_constructed_depth_ = std::max(v1->get_depth(), max_constructed_depth_);
-        double delta = default_policy(v1);
-        backup(v1, delta);
+      std::size_t num_iterations = cfg_.num_iterations ? cfg_.num_iterations : std::numeric_limits<std::size_t>::max();
+      clock::time_point deadline = clock::time_point::max();
+      if (cfg_.time_limit > 0) {
+        deadline = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(cfg_.time_limit));
+      }
+      std::size_t round = num_iterations;
+      if (trees_.size() > 1 && cfg_.sync_interval) {
+        round = cfg_.sync_interval * trees_.size();
+      }
+      for (std::size_t done = 0; done < num_iterations; ) {
+        std::size_t n = std::min(round, num_iterations - done);
+        std::size_t ran = run(n, deadline);
+        done += ran;
+        bool finished = ran < n || done == num_iterations;
+        if (trees_.size() > 1) {
+          merge_roots(finished);
+        }
+        if (finished) {
+          break;
+        }
       }
 
-      duration time_elapsed = clock::now() - start;
-      float seconds = time_elapsed.count();
+      end_ = clock::now();
+      searching_ = false;
+      return get_status();
+    }
+
+    /**
+     * Primary driver for UCT in which we explore/expand,
+     * simulate, and backpropagate findings, on as many
+     * threads as the config asks for
+     */
+    void search() {
+      status_type status = explore();
+      float seconds = status.seconds;
+      std::size_t num_iterations = status.num_iterations;
       std::cout << "High score: " << high_score_ << std::endl;
       std::cout << "High scoring sequence of moves: ";
       print(best_seq_);
-      std::cout << "Constructed " << total_nodes_ << " game tree nodes up to depth " 
-        << max_constructed_depth_ << std::endl;
-      std::size_t num_terminal_revisits = num_iterations_ - total_nodes_ + 1;
-      std::cout << "Re-visited terminal nodes " << num_terminal_revisits << " times (" 
-        << (num_terminal_revisits / static_cast<double>(num_iterations_) * 100) << "% waste)" << std::endl;
-      std::cout << "Took " << seconds << "s " << "(" << (num_iterations_ / seconds) 
-        << " iterations per second)" << std::endl;
-    }
-}; 
+      std::size_t num_nodes = 0;
+      std::size_t num_transpositions = 0;
+      for (const auto& t : trees_) {
+        num_nodes += t->get_num_nodes();
+        num_transpositions += t->get_num_transpositions();
+      }
+      std::cout << "Constructed " << num_nodes << " game tree nodes in " << trees_.size()
+        << " tree(s) up to depth " << max_constructed_depth_ << std::endl;
+      if (cfg_.transpositions) {
+        std::cout << "Merged " << num_transpositions << " transpositions" << std::endl;
+      }
+      // revisits of terminal nodes and iterations which ended on a
+      // transposition build no new node
+      std::size_t num_revisits = num_iterations - num_expansions_;
+      std::cout << "Built no new node in " << num_revisits << " iterations ("
+        << (num_revisits / static_cast<double>(num_iterations) * 100) << "% waste)" << std::endl;
+      const auto& root = get_tree()[get_tree().get_root()];
+      if (root.is_solved()) {
+        std::cout << "Solved the root: the best reachable score is " << root.get_value() << std::endl;
+      }
+      std::cout << "Took " << seconds << "s " << "(" << (num_iterations / seconds)
+        << " iterations per second on " << workers_.size() << " threads)" << std::endl;
+    }
+
+    /**
+     * Plays a whole game from the root. Before each move the
+     * tree is searched for the configured number of iterations,
+     * then the most visited child of the root (or a solved one
+     * which reaches the high score) is played and the
+     * tree is re-rooted at it, so that the statistics of its
+     * subtree carry over to the next search and the rest of the
+     * tree is freed. Prints the time each move took.
+     *
+     * @return the moves played
+     */
+    std::vector<move_type> play() {
+      while (!get_tree()[get_tree().get_root()].is_terminal()) {
+        std::size_t reused = get_tree().get_num_nodes();
+        status_type status = explore();
+        float seconds = status.seconds;
+
+        const tree_type& t = get_tree();
+        index_type root = t.get_root();
+        if (t[root].get_num_children() == 0) {
+          // the search was stopped or ran out of time before its first
+          // iteration, so there is nothing to choose from but the first move
+          trees_.front()->expand(root);
+        }
+        index_type best = 0;
+        index_type best_solved = no_index;
+        for (index_type i = 0; i < t[root].get_num_children(); i++) {
+          const auto& child = t[t.get_child(root, i)];
+          if (child.get_n() > t[t.get_child(root, best)].get_n()) {
+            best = i;
+          }
+          if (child.is_solved() &&
+              (best_solved == no_index || child.get_value() > t[t.get_child(root, best_solved)].get_value())) {
+            best_solved = i;
+          }
+        }
+        // search skips solved children, so their visit counts stop growing.
+        // one which is known to reach the best score seen is played instead
+        if (best_solved != no_index &&
+            (t[root].is_solved() || t[t.get_child(root, best_solved)].get_value() >= high_score_)) {
+          best = best_solved;
+        }
+        move_type move = t[t[root].get_first_child() + best].get_move();
+        std::cout << "Move " << played_.size() + 1 << ": " << move << " took " << seconds << "s ("
+          << (status.num_iterations / seconds) << " iterations per second, "
+          << reused << " nodes reused)" << std::endl;
+        advance(best);
+      }
+
+      Game final(workers_.front().playout_);
+      get_tree().load_state(get_tree().get_root(), final);
+      std::cout << "Final score: " << final.get_cumulative_reward() << std::endl;
+      std::cout << "Moves played: ";
+      print(played_);
+      std::cout << "High score seen while searching: " << high_score_ << std::endl;
+      return played_;
+    }
+
+  private:
+    /**
+     * plays a move by re-rooting every tree at the root child with the given
+     * index. trees which haven't expanded that child start afresh from it.
+     *
+     * @param i the index of the child among the root's children
+     */
+    void advance(index_type i) {
+      const tree_type& first = get_tree();
+      move_type move = first[first[first.get_root()].get_first_child() + i].get_move();
+      Game next(workers_.front().playout_);
+      first.load_state(first.get_root(), next);
+      next.apply(move);
+      std::vector<std::unique_ptr<tree_type>> trees;
+      for (const auto& t : trees_) {
+        index_type root = t->get_root();
+        if (i < (*t)[root].get_num_children()) {
+          trees.push_back(std::make_unique<tree_type>(*t, t->get_child(root, i)));
+        } else {
+          trees.push_back(std::make_unique<tree_type>(next, cfg_.checkpoint_interval, cfg_.transpositions));
+        }
+      }
+      {
+        std::lock_guard<std::mutex> guard(trees_mutex_);
+        trees_.swap(trees);
+      }
+      for (std::size_t k = 0; k < workers_.size(); k++) {
+        workers_[k].tree_ = trees_[k % trees_.size()].get();
+        workers_[k].loaded_ = no_index;
+      }
+      played_.push_back(move);
+    }
+
+    /**
+     * runs iterations on every worker until n have been run between them, the
+     * deadline passes or the search is stopped. a worker also stops once the
+     * root of its tree is solved. the first worker runs on this thread and
+     * calls the progress callback.
+     *
+     * @param n the number of iterations
+     * @param deadline the time to stop by
+     * @return the number of iterations run
+     */
+    std::size_t run(std::size_t n, clock::time_point deadline) {
+      std::atomic<std::size_t> next_iteration(0);
+      std::atomic<std::size_t> num_run(0);
+      auto work = [this, n, deadline, &next_iteration, &num_run](worker& w, bool reporting) {
+        clock::time_point next_report = clock::now() + std::chrono::duration_cast<clock::duration>(
+          std::chrono::duration<double>(progress_interval_));
+        while (!stop_requested_.load(std::memory_order_relaxed) &&
+               next_iteration.fetch_add(1, std::memory_order_relaxed) < n) {
+          if (clock::now() >= deadline || (*w.tree_)[w.tree_->get_root()].is_solved()) {
+            break;
+          }
+          index_type v1 = tree_policy(w.tree_->get_root(), w);
+          if (v1 == no_index) {
+            // the root was solved while this iteration was under way
+            break;
+          }
+          int depth = w.tree_->get_depth(v1);
+          int max_depth = max_constructed_depth_.load(std::memory_order_relaxed);
+          while (depth > max_depth && !max_constructed_depth_.compare_exchange_weak(max_depth, depth)) {}
+          double delta = default_policy(v1, w);
+          backup(w, delta);
+          num_run.fetch_add(1, std::memory_order_relaxed);
+          num_iterations_run_.fetch_add(1, std::memory_order_relaxed);
+          if (reporting && on_progress_ && clock::now() >= next_report) {
+            on_progress_(get_status());
+            next_report = clock::now() + std::chrono::duration_cast<clock::duration>(
+              std::chrono::duration<double>(progress_interval_));
+          }
+        }
+      };
+      std::vector<std::thread> threads;
+      for (std::size_t k = 1; k < workers_.size(); k++) {
+        threads.emplace_back(work, std::ref(workers_[k]), false);
+      }
+      work(workers_.front(), true);
+      for (std::thread& t : threads) {
+        t.join();
+      }
+      return num_run;
+    }
+
+    /**
+     * sums the statistics of the root children over every tree. At a sync
+     * point every tree's root children are then given the mean, and at the
+     * end the first tree's are given the sum. Root children which a tree
+     * hasn't expanded yet are expanded first, and the roots' own statistics
+     * are set to the totals of their children. A root child solved in any
+     * tree is marked solved in every tree which is written to.
+     *
+     * @param final true at the end of the search, false at a sync point
+     */
+    void merge_roots(bool final) {
+      const auto& first = *trees_.front();
+      std::size_t num_moves = first[first.get_root()].get_num_moves();
+      std::vector<std::size_t> n(num_moves, 0);
+      std::vector<double> q(num_moves, 0);
+      std::vector<std::optional<double>> values(num_moves);
+      for (const auto& t : trees_) {
+        const auto& root = (*t)[t->get_root()];
+        for (index_type i = 0; i < root.get_num_children(); i++) {
+          const auto& child = (*t)[t->get_child(t->get_root(), i)];
+          n[i] += child.get_n();
+          q[i] += child.get_q_total();
+          if (child.is_solved()) {
+            values[i] = child.get_value();
+          }
+        }
+      }
+
+      index_type num_visited = num_moves;
+      while (num_visited > 0 && n[num_visited - 1] == 0) {
+        num_visited--;
+      }
+
+      std::size_t divisor = final ? 1 : trees_.size();
+      for (std::size_t k = 0; k < (final ? 1 : trees_.size()); k++) {
+        tree_type& t = *trees_[k];
+        auto& root = t[t.get_root()];
+        std::size_t root_n = 0;
+        double root_q = 0;
+        while (root.get_num_children() < num_visited) {
+          t.expand(t.get_root());
+        }
+        for (index_type i = 0; i < num_visited; i++) {
+          std::size_t child_n = n[i] / divisor;
+          double child_q = child_n ? q[i] / n[i] * child_n : 0;
+          t[t.get_child(t.get_root(), i)].set_n(child_n);
+          t[t.get_child(t.get_root(), i)].set_q_total(child_q);
+          if (values[i]) {
+            t[t.get_child(t.get_root(), i)].set_solved(*values[i]);
+          }
+          root_n += child_n;
+          root_q += child_q;
+        }
+        root.set_n(root_n);
+        root.set_q_total(root_q);
+        t.try_solve(t.get_root());
+      }
+    }
+
+    index_type tree_policy(index_type v0, worker& w) {
+      tree_type& t = *w.tree_;
+      index_type cur = v0;
+      bool counted = false;
+      w.path_.clear();
+      while (true) {
+        if (!counted && !t[cur].is_solved()) {
+          t[cur].add_virtual_loss(cfg_.virtual_loss);
+          w.path_.push_back(cur);
+          counted = true;
+        }
+        if (t[cur].is_solved()) {
+          // another thread solved cur after it was picked, so a visit ending
+          // here would reach none of its children. take back the visits on
+          // the path and start again, unless it is v0 that is solved
+          for (index_type v : w.path_) {
+            t[v].remove_virtual_loss(cfg_.virtual_loss);
+          }
+          w.path_.clear();
+          if (cur == v0) {
+            return no_index;
+          }
+          cur = v0;
+          counted = false;
+          continue;
+        }
+        if (t[cur].get_num_children() < t[cur].get_num_moves()) {
+          bool linked;
+          index_type child = t.expand(cur, w.playout_, linked);
+          if (child != no_index) {
+            w.loaded_ = child;
+            if (!linked) {
+              num_expansions_++;
+            }
+            w.path_.push_back(child);
+            t[child].add_virtual_loss(cfg_.virtual_loss);
+            return child;
+          }
+        }
+        index_type next = t.best_child(cur);
+        if (next == no_index) {
+          // every child so far is solved. either cur is too, or another
+          // thread is making its next child, so give up the cpu to it rather
+          // than spin until it is done
+          if (!t.try_solve(cur)) {
+            std::this_thread::yield();
+          }
+          continue;
+        }
+        cur = next;
+        counted = false;
+      }
+    }
+
+    double default_policy(index_type v, worker& w) {
+      const auto& nd = (*w.tree_)[v];
+      if (nd.is_solved()) {
+        // no playout can do better than the known value
+        w.loaded_ = no_index;
+        w.random_seq_.clear();
+        if (nd.is_terminal()) {
+          record(v, nd.get_value(), w.random_seq_, *w.tree_);
+        }
+        return nd.get_value();
+      }
+      if (w.loaded_ != v) {
+        w.tree_->load_state(v, w.playout_);
+      }
+      w.loaded_ = no_index;
+      if (w.leaf_playouts_.empty()) {
+        w.random_seq_.clear();
+        double reward = play_out(w.playout_, w.rng_, [&w](const auto& move) {
+          w.random_seq_.push_back(move);
+        }).reward;
+        record(v, reward, w.random_seq_, *w.tree_);
+        return reward;
+      }
+
+      w.leaf_pool_->run(w.leaf_playouts_.size(), [&w](std::size_t i) {
+        leaf_playout& p = w.leaf_playouts_[i];
+        p.playout_ = w.playout_;
+        p.random_seq_.clear();
+        p.reward_ = play_out(p.playout_, p.rng_, [&p](const auto& move) {
+          p.random_seq_.push_back(move);
+        }).reward;
+      });
+      double total = 0;
+      for (const leaf_playout& p : w.leaf_playouts_) {
+        total += p.reward_;
+        record(v, p.reward_, p.random_seq_, *w.tree_);
+      }
+      return total / w.leaf_playouts_.size();
+    }
+
+    /**
+     * keeps the sequence of a playout if it beats the high score
+     *
+     * @param v the index of the node the playout started from
+     * @param reward the reward of the playout
+     * @param random_seq the moves of the playout
+     * @param t the tree v is in
+     */
+    void record(index_type v, double reward, const std::vector<move_type>& random_seq, const tree_type& t) {
+      if (reward > high_score_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(best_mutex_);
+        if (reward > high_score_.load(std::memory_order_relaxed)) {
+          high_score_.store(reward, std::memory_order_relaxed);
+          std::vector<move_type> seq = t.get_seq(v);
+          best_seq_ = played_;
+          best_seq_.insert(best_seq_.end(), seq.begin(), seq.end());
+          best_seq_.insert(best_seq_.end(), random_seq.begin(), random_seq.end());
+        }
+      }
+    }
+
+    void backup(worker& w, double delta) {
+      for (index_type v : w.path_) {
+        (*w.tree_)[v].add_reward(delta, cfg_.virtual_loss);
+      }
+      for (auto it = w.path_.rbegin(); it != w.path_.rend() && w.tree_->try_solve(*it); ++it) {}
+    }
+};
 
 }
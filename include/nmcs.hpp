@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "playout_state.hpp"
+#include "thread_pool.hpp"
+#include "util.hpp"
+
+namespace mcts
+{
+
+/**
+ * Nested Monte Carlo Search for single-player games. A level 0 search is a
+ * random playout. A level n search plays a game out move by move: before
+ * each move it runs a level n-1 search after every available move, and it
+ * then plays the next move of the best sequence found so far, which it keeps
+ * even when later searches don't match it.
+ *
+ * The level 1 searches run by each level 2 step are independent, so they are
+ * spread over a thread pool (with a level 1 search, its playouts are). Each
+ * move searched at once gets its own random number generator. The game's
+ * moves and playouts must be safe to run on separate states at once.
+ */
+template <class Game>
+class nmcs {
+  public:
+    using move_type = typename Game::move_type;
+
+    /**
+     * a sequence of moves and the final score it reaches
+     */
+    struct sequence {
+      double score;
+      std::vector<move_type> moves;
+    };
+  private:
+    Game root_;
+    int level_;
+    int parallel_level_;
+    std::size_t num_threads_;
+    thread_pool pool_;
+    std::vector<std::minstd_rand> rngs_;
+    std::minstd_rand rng_;
+    sequence best_;
+
+    static int check_level(int level) {
+      if (level < 1) {
+        throw std::invalid_argument("nmcs needs a nesting level of at least 1");
+      }
+      return level;
+    }
+
+    static std::size_t check_num_threads(std::size_t num_threads) {
+      if (num_threads == 0) {
+        throw std::invalid_argument("nmcs needs at least one thread");
+      }
+      return num_threads;
+    }
+
+    /**
+     * plays a game out randomly
+     *
+     * @param state the game to play out
+     * @param rng the random bit generator used to pick moves
+     * @return the score and the moves of the playout
+     */
+    template <class URBG>
+    static sequence playout(Game state, URBG& rng) {
+      sequence result;
+      result.score = play_out(state, rng, [&result](const move_type& move) {
+        result.moves.push_back(move);
+      }).reward;
+      return result;
+    }
+
+    /**
+     * runs a search at some level from a game state
+     *
+     * @param state the game state to search from
+     * @param level the nesting level, at least 1
+     * @param rng the random bit generator used by the playouts below, unless
+     * they run in parallel
+     * @return the best sequence found from state
+     */
+    template <class URBG>
+    sequence nested(Game state, int level, URBG& rng) {
+      sequence best{-std::numeric_limits<double>::max(), {}};
+      std::vector<move_type> played;
+      std::vector<sequence> results;
+      for (auto moves = state.get_available_moves(); !moves.empty(); moves = state.get_available_moves()) {
+        results.resize(moves.size());
+        auto search_after = [&](std::size_t i, auto& r) {
+          Game child(state);
+          child.apply(moves[i]);
+          results[i] = level == 1 ? playout(child, r) : nested(child, level - 1, r);
+        };
+        if (level == parallel_level_) {
+          while (rngs_.size() < moves.size()) {
+            rngs_.emplace_back(std::rand());
+          }
+          pool_.run(moves.size(), [&](std::size_t i) {
+            search_after(i, rngs_[i]);
+          });
+        } else {
+          for (std::size_t i = 0; i < moves.size(); i++) {
+            search_after(i, rng);
+          }
+        }
+
+        for (std::size_t i = 0; i < moves.size(); i++) {
+          if (results[i].score > best.score) {
+            best.score = results[i].score;
+            best.moves = played;
+            best.moves.push_back(moves[i]);
+            best.moves.insert(best.moves.end(), results[i].moves.begin(), results[i].moves.end());
+          }
+        }
+        move_type next = best.moves[played.size()];
+        state.apply(next);
+        played.push_back(next);
+      }
+
+      if (played.empty()) {
+        best.score = state.get_cumulative_reward();
+      }
+      return best;
+    }
+
+  public:
+    /**
+     * nmcs constructor. throws std::invalid_argument if the level or the
+     * number of threads is below 1
+     *
+     * @param root the game state to search from
+     * @param level the nesting level, at least 1
+     * @param num_threads the number of threads running level 1 searches
+     */
+    explicit nmcs(const Game& root, int level = 2, std::size_t num_threads = 1)
+      : root_(root),
+        level_(check_level(level)),
+        parallel_level_(std::min(level_, 2)),
+        num_threads_(check_num_threads(num_threads)),
+        pool_(num_threads_ - 1),
+        rng_(std::rand()),
+        best_{-std::numeric_limits<double>::max(), {}}
+    {}
+
+    /**
+     * getter for the best sequence found by the last search
+     *
+     * @return the moves of the best sequence and its score
+     */
+    const sequence& get_best() const noexcept {
+      return best_;
+    }
+
+    /**
+     * runs the search and prints the best sequence it found and the time it took
+     *
+     * @return the best sequence found
+     */
+    const sequence& search() {
+      using clock = std::chrono::high_resolution_clock;
+      using duration = std::chrono::duration<float>;
+      clock::time_point start = clock::now();
+
+      best_ = nested(root_, level_, rng_);
+
+      duration time_elapsed = clock::now() - start;
+      float seconds = time_elapsed.count();
+      std::cout << "High score: " << best_.score << std::endl;
+      std::cout << "High scoring sequence of moves: ";
+      print(best_.moves);
+      std::cout << "Took " << seconds << "s (level " << level_ << " on "
+        << num_threads_ << " threads)" << std::endl;
+      return best_;
+    }
+};
+
+}
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "mcts.hpp"
+#include "thread_pool.hpp"
+#include "util.hpp"
+
+namespace mcts
+{
+
+/**
+ * The weights of an NRPA rollout policy, keyed by move code (see
+ * nrpa). Codes without a weight have weight 0. The weights are kept in a
+ * flat open addressing table with linear probing, so looking one up is a
+ * multiply and a short scan of an array rather than a walk through buckets.
+ */
+class policy_table {
+  private:
+    static constexpr std::uint32_t empty = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> codes_;
+    std::vector<double> weights_;
+    std::size_t size_;
+    int bits_;
+
+    std::size_t slot(std::uint32_t code) const noexcept {
+      std::size_t mask = codes_.size() - 1;
+      std::size_t i = (code * 0x9E3779B97F4A7C15ull) >> (64 - bits_);
+      while (codes_[i] != empty && codes_[i] != code) {
+        i = (i + 1) & mask;
+      }
+      return i;
+    }
+
+    void grow() {
+      std::vector<std::uint32_t> codes(std::move(codes_));
+      std::vector<double> weights(std::move(weights_));
+      bits_++;
+      codes_.assign(std::size_t(1) << bits_, empty);
+      weights_.assign(std::size_t(1) << bits_, 0);
+      for (std::size_t i = 0; i < codes.size(); i++) {
+        if (codes[i] != empty) {
+          std::size_t j = slot(codes[i]);
+          codes_[j] = codes[i];
+          weights_[j] = weights[i];
+        }
+      }
+    }
+  public:
+    policy_table()
+      : codes_(64, empty),
+        weights_(64, 0),
+        size_(0),
+        bits_(6)
+    {}
+
+    /**
+     * gets the weight of a move code
+     *
+     * @param code the move code
+     * @return the weight of the code, or 0 if it has none
+     */
+    double get(std::uint32_t code) const noexcept {
+      std::size_t i = slot(code);
+      return codes_[i] == empty ? 0 : weights_[i];
+    }
+
+    /**
+     * adds to the weight of a move code
+     *
+     * @param code the move code
+     * @param delta the amount to add
+     */
+    void add(std::uint32_t code, double delta) {
+      assert(code != empty);
+      if (2 * (size_ + 1) > codes_.size()) {
+        grow();
+      }
+      std::size_t i = slot(code);
+      if (codes_[i] == empty) {
+        codes_[i] = code;
+        size_++;
+      }
+      weights_[i] += delta;
+    }
+
+    /**
+     * gets the number of move codes with a weight
+     *
+     * @return the number of codes in the table
+     */
+    std::size_t size() const noexcept {
+      return size_;
+    }
+};
+
+/**
+ * settings for an nrpa search
+ */
+struct nrpa_config {
+  // the nesting level of the search, at least 1
+  int level = 3;
+  // the number of iterations run by the search at each level
+  std::size_t num_iterations = 100;
+  // the learning rate of the policy
+  double alpha = 1;
+  // the number of threads running level 1 searches
+  std::size_t num_threads = 1;
+  // the number of seconds of wall-clock time the search may take, or 0 for
+  // no limit
+  double time_limit = 0;
+};
+
+/**
+ * Nested Rollout Policy Adaptation for single-player games. A level 0 search
+ * is a playout from the root which picks each move with probability
+ * proportional to exp(weight of its code) under a policy. A level n search
+ * runs level n-1 searches from a copy of its policy, keeps the best sequence
+ * found so far, and after every iteration adapts its policy towards that
+ * sequence: the weight of each move played goes up by alpha and the weights
+ * of the moves available alongside it go down in proportion to how likely
+ * the policy made them.
+ *
+ * Games give each move a code with Game::move_code(move), which should tell
+ * moves apart along with any context that they should be learned separately
+ * in. The policy is a policy_table over those codes.
+ *
+ * The level 1 searches run by level 2 are spread over a thread pool (with a
+ * level 1 search, its playouts are). They run in batches of one per thread
+ * from the same policy, and the level 2 search then takes in their results
+ * one at a time in order, adapting its policy after each, as it would if it
+ * had run them one after the other from a policy a few iterations stale.
+ *
+ * Like uct, it reports a search_status, and a search can be bounded by time
+ * or ended with stop().
+ */
+template <class Game>
+class nrpa {
+  public:
+    using move_type = typename Game::move_type;
+    using status_type = search_status<move_type>;
+
+    /**
+     * a sequence of moves from the root and the final score it reaches
+     */
+    struct sequence {
+      double score;
+      std::vector<move_type> moves;
+    };
+  private:
+    using clock = std::chrono::steady_clock;
+
+    Game root_;
+    nrpa_config cfg_;
+    int parallel_level_;
+    thread_pool pool_;
+    std::vector<std::minstd_rand> rngs_;
+    std::minstd_rand rng_;
+    std::mutex best_mutex_;
+    std::atomic<double> high_score_;
+    std::vector<move_type> best_seq_;
+    std::atomic<std::size_t> num_playouts_;
+    std::atomic<bool> searching_;
+    std::atomic<bool> stop_requested_;
+    std::atomic<clock::time_point> start_;
+    std::atomic<clock::time_point> end_;
+    clock::time_point deadline_;
+
+    static const nrpa_config& check(const nrpa_config& cfg) {
+      if (cfg.level < 1) {
+        throw std::invalid_argument("nrpa needs a nesting level of at least 1");
+      }
+      if (cfg.num_threads == 0) {
+        throw std::invalid_argument("nrpa needs at least one thread");
+      }
+      return cfg;
+    }
+
+    bool should_stop() const noexcept {
+      return stop_requested_.load(std::memory_order_relaxed) || clock::now() >= deadline_;
+    }
+
+    /**
+     * plays a game out from the root following a policy
+     *
+     * @param pol the policy
+     * @param rng the random bit generator used to pick moves
+     * @return the score and the moves of the playout
+     */
+    template <class URBG>
+    sequence playout(const policy_table& pol, URBG& rng) {
+      Game state(root_);
+      sequence result;
+      std::vector<double> weights;
+      for (auto moves = state.get_available_moves(); !moves.empty(); moves = state.get_available_moves()) {
+        weights.resize(moves.size());
+        double total = 0;
+        for (std::size_t i = 0; i < moves.size(); i++) {
+          weights[i] = std::exp(pol.get(state.move_code(moves[i])));
+          total += weights[i];
+        }
+        double x = std::uniform_real_distribution<double>(0, total)(rng);
+        std::size_t pick = 0;
+        for (; pick + 1 < moves.size() && x >= weights[pick]; pick++) {
+          x -= weights[pick];
+        }
+        result.moves.push_back(moves[pick]);
+        state.apply(moves[pick]);
+      }
+      result.score = state.get_cumulative_reward();
+      num_playouts_.fetch_add(1, std::memory_order_relaxed);
+
+      if (result.score > high_score_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(best_mutex_);
+        if (result.score > high_score_.load(std::memory_order_relaxed)) {
+          high_score_.store(result.score, std::memory_order_relaxed);
+          best_seq_ = result.moves;
+        }
+      }
+      return result;
+    }
+
+    /**
+     * adapts a policy towards a sequence of moves from the root
+     *
+     * @param pol the policy to adapt
+     * @param moves the sequence
+     */
+    void adapt(policy_table& pol, const std::vector<move_type>& moves) const {
+      policy_table old(pol);
+      Game state(root_);
+      std::vector<double> weights;
+      for (const move_type& move : moves) {
+        const auto& available = state.get_available_moves();
+        weights.resize(available.size());
+        double total = 0;
+        for (std::size_t i = 0; i < available.size(); i++) {
+          weights[i] = std::exp(old.get(state.move_code(available[i])));
+          total += weights[i];
+        }
+        pol.add(state.move_code(move), cfg_.alpha);
+        for (std::size_t i = 0; i < available.size(); i++) {
+          pol.add(state.move_code(available[i]), -cfg_.alpha * weights[i] / total);
+        }
+        state.apply(move);
+      }
+    }
+
+    /**
+     * runs a search at some level
+     *
+     * @param level the nesting level
+     * @param pol the policy to start from
+     * @param rng the random bit generator used by the playouts below, unless
+     * they run in parallel
+     * @return the best sequence found
+     */
+    template <class URBG>
+    sequence nested(int level, policy_table pol, URBG& rng) {
+      if (level == 0) {
+        return playout(pol, rng);
+      }
+      sequence best{-std::numeric_limits<double>::max(), {}};
+      std::vector<sequence> results;
+      for (std::size_t i = 0; i < cfg_.num_iterations && !should_stop(); ) {
+        if (level == parallel_level_) {
+          results.resize(std::min(rngs_.size(), cfg_.num_iterations - i));
+          pool_.run(results.size(), [&](std::size_t j) {
+            results[j] = nested(level - 1, pol, rngs_[j]);
+          });
+        } else {
+          results.assign(1, nested(level - 1, pol, rng));
+        }
+        for (const sequence& result : results) {
+          if (result.score >= best.score) {
+            best = result;
+          }
+          adapt(pol, best.moves);
+        }
+        i += results.size();
+      }
+      return best;
+    }
+
+  public:
+    /**
+     * nrpa constructor. throws std::invalid_argument if the level or the
+     * number of threads is below 1
+     *
+     * @param root the game state to search from
+     * @param cfg the settings of the search
+     */
+    nrpa(const Game& root, const nrpa_config& cfg)
+      : root_(root),
+        cfg_(check(cfg)),
+        parallel_level_(std::min(cfg.level, 2)),
+        pool_(cfg_.num_threads - 1),
+        rng_(std::rand()),
+        high_score_(-std::numeric_limits<double>::max()),
+        num_playouts_(0),
+        searching_(false),
+        stop_requested_(false),
+        start_(clock::time_point()),
+        end_(clock::time_point())
+    {
+      for (std::size_t i = 0; i < cfg_.num_threads; i++) {
+        rngs_.emplace_back(std::rand());
+      }
+    }
+
+    /**
+     * asks the current search to end, which it does after the playouts it is
+     * running. may be called from any thread.
+     */
+    void stop() noexcept {
+      stop_requested_.store(true);
+    }
+
+    /**
+     * takes a snapshot of the current or last search. may be called from any
+     * thread while the search runs. num_iterations counts playouts, and
+     * root_visits is left empty as there is no tree.
+     *
+     * @return the status of the search
+     */
+    status_type get_status() {
+      status_type status;
+      status.num_iterations = num_playouts_.load();
+      clock::time_point end = searching_.load() ? clock::now() : end_.load();
+      status.seconds = std::chrono::duration<double>(end - start_.load()).count();
+      std::lock_guard<std::mutex> guard(best_mutex_);
+      status.high_score = high_score_;
+      status.best_seq = best_seq_;
+      return status;
+    }
+
+    /**
+     * runs a search without printing anything
+     *
+     * @return the status at the end of the search
+     */
+    status_type explore() {
+      clock::time_point start = clock::now();
+      start_ = start;
+      deadline_ = clock::time_point::max();
+      if (cfg_.time_limit > 0) {
+        deadline_ = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(cfg_.time_limit));
+      }
+      num_playouts_ = 0;
+      stop_requested_ = false;
+      searching_ = true;
+
+      nested(cfg_.level, policy_table(), rng_);
+
+      end_ = clock::now();
+      searching_ = false;
+      return get_status();
+    }
+
+    /**
+     * runs a search and prints the best sequence it found and the time it took
+     */
+    void search() {
+      status_type status = explore();
+      std::cout << "High score: " << status.high_score << std::endl;
+      std::cout << "High scoring sequence of moves: ";
+      print(status.best_seq);
+      std::cout << "Took " << status.seconds << "s " << "(" << (status.num_iterations / status.seconds)
+        << " playouts per second on " << cfg_.num_threads << " threads)" << std::endl;
+    }
+};
+
+}
@@ -2,10 +2,12 @@
 #include <fstream>
 #include <iostream>
 #include <mutex>
+#include <random>
 #include <thread>
 #include <utility>
 #include <vector>
 
+#include "playout_state.hpp"
 #include "simulator_node.hpp"
 #include "util.hpp"
 
@@ -34,18 +36,8 @@ class partial_tree_simulator {
     std::mutex io_mutex_;
     std::mutex progress_mutex_;
 
-    void rollout(node_type* node, std::vector<state_statistics>& range_stats) {
-      std::vector<double> rewards;
-      for (std::size_t i = 0; i < rollouts_per_node_; i++) {
-        Game g(node->get_game());
-        auto moves = g.get_available_moves();
-        while (!moves.empty()) {
-          int random_idx = std::rand() % moves.size();
-          g = g.make_move(moves[random_idx]);
-          moves = g.get_available_moves();
-        }
-        rewards.push_back(g.get_cumulative_reward());
-      } 
+    void rollout(node_type* node, std::vector<state_statistics>& range_stats, std::minstd_rand& rng) {
+      std::vector<double> rewards = play_out_many(node->get_game(), rollouts_per_node_, rng);
 
       double reward_mean = mean(rewards);
       double reward_sd = stddev(rewards);
@@ -65,6 +57,8 @@ class partial_tree_simulator {
     void rollout_range(std::vector<node_type*>& worklist, std::size_t start_idx, 
         std::size_t end_idx, std::size_t& progress) {
       std::vector<state_statistics> range_stats;
+      // each worker draws from its own generator rather than contending on std::rand
+      std::minstd_rand rng(std::rand());
       for (std::size_t i = start_idx; i < worklist.size() && i < end_idx; i++) {
         if (i % 1000 == 0 && i != 0) {
           std::lock_guard progress_guard(progress_mutex_);
@@ -72,7 +66,7 @@ class partial_tree_simulator {
           std::cout << "[" << progress << "/" << worklist_.size() << "] (" 
             << (progress / worklist_.size() * 100) << "%)" << std::endl;
         }
-        rollout(worklist[i], range_stats);
+        rollout(worklist[i], range_stats, rng);
       }
     }
 
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * the outcome of playing a game out to the end
+ */
+struct playout_result {
+  double reward;
+  int num_moves;
+};
+
+/**
+ * detects whether a game provides its own playout kernel, i.e. whether
+ * random_playout(state, rng, on_move) can be found for it by argument
+ * dependent lookup
+ */
+template <class Game, class URBG, class MoveSink, class = void>
+struct has_random_playout : std::false_type {};
+
+template <class Game, class URBG, class MoveSink>
+struct has_random_playout<Game, URBG, MoveSink, std::void_t<decltype(random_playout(
+    std::declval<Game&>(), std::declval<URBG&>(), std::declval<MoveSink&>()))>>
+  : std::true_type {};
+
+/**
+ * plays state out in place by taking uniformly random moves until none are
+ * left. Games which provide a random_playout kernel (see has_random_playout)
+ * play out through it, and everything else falls back to repeatedly applying
+ * a random move from the available move list.
+ *
+ * @param state the game to play out, which is left in its final state
+ * @param rng the random bit generator used to pick moves
+ * @param on_move called with each move in the order they are taken
+ * @return the final cumulative reward and the number of moves taken
+ */
+template <class Game, class URBG, class MoveSink>
+playout_result play_out(Game& state, URBG& rng, MoveSink&& on_move) {
+  if constexpr (has_random_playout<Game, URBG, MoveSink>::value) {
+    return random_playout(state, rng, on_move);
+  } else {
+    int num_moves = 0;
+    const auto& moves = state.get_available_moves();
+    while (!moves.empty()) {
+      auto move = moves[rng() % moves.size()];
+      state.apply(move);
+      on_move(move);
+      num_moves++;
+    }
+    return {state.get_cumulative_reward(), num_moves};
+  }
+}
+
+/**
+ * plays state out in place by taking uniformly random moves until none are left
+ *
+ * @param state the game to play out, which is left in its final state
+ * @param rng the random bit generator used to pick moves
+ * @return the final cumulative reward and the number of moves taken
+ */
+template <class Game, class URBG>
+playout_result play_out(Game& state, URBG& rng) {
+  return play_out(state, rng, [](const auto&) {});
+}
+
+/**
+ * detects whether a game provides its own batched playouts, i.e. whether
+ * random_playouts(state, n, rng) can be found for it by argument dependent lookup
+ */
+template <class Game, class URBG, class = void>
+struct has_random_playouts : std::false_type {};
+
+template <class Game, class URBG>
+struct has_random_playouts<Game, URBG, std::void_t<decltype(random_playouts(
+    std::declval<const Game&>(), std::declval<std::size_t>(), std::declval<URBG&>()))>>
+  : std::true_type {};
+
+/**
+ * plays n independent copies of state out with uniformly random moves. Games
+ * which provide random_playouts (see has_random_playouts) play them all through
+ * it, and everything else plays out one copy at a time.
+ *
+ * @param state the game to play out
+ * @param n the number of playouts
+ * @param rng the random bit generator used to pick moves
+ * @return the final cumulative reward of each playout
+ */
+template <class Game, class URBG>
+std::vector<double> play_out_many(const Game& state, std::size_t n, URBG& rng) {
+  if constexpr (has_random_playouts<Game, URBG>::value) {
+    return random_playouts(state, n, rng);
+  } else {
+    std::vector<double> rewards;
+    rewards.reserve(n);
+    for (std::size_t i = 0; i < n; i++) {
+      Game copy(state);
+      rewards.push_back(play_out(copy, rng).reward);
+    }
+    return rewards;
+  }
+}
@@ -3,6 +3,8 @@
 namespace random_engine
 {
 
-extern std::default_random_engine generator;
+// each thread has its own generator, so games which draw from it can be
+// played out on several threads at once
+extern thread_local std::default_random_engine generator;
 
 }
\ No newline at end of file
@@ -14,6 +14,11 @@ struct config {
   std::string board_layout_file;
 };
 
+bool operator==(const config& lhs, const config& rhs) {
+  return lhs.width == rhs.width && lhs.height == rhs.height
+    && lhs.board_layout_file == rhs.board_layout_file;
+}
+
 config get_config_from_toml(std::string toml_file_path) {
   auto tbl = cpptoml::parse_file(toml_file_path);
   config cfg;
@@ -42,12 +47,12 @@ class game {
   public:
     using move_type = move;
   private:
-    config cfg_;
+    const config* cfg_;
     using board_type = std::vector<std::vector<tile>>;
     board_type board_;
   public:
     game(config cfg)
-      : cfg_(cfg) {
+      : cfg_(intern(cfg)) {
       
     }
 
@@ -1,8 +1,17 @@
 #pragma once
 
-#include <set>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 
 #include "cpptoml.hpp"
+#include "playout_state.hpp"
+#include "static_vector.hpp"
 #include "util.hpp"
 
 namespace same_game
@@ -17,6 +26,11 @@ struct config {
   std::string board_layout_file;
 };
 
+bool operator==(const config& lhs, const config& rhs) {
+  return lhs.width == rhs.width && lhs.height == rhs.height
+    && lhs.board_layout_file == rhs.board_layout_file;
+}
+
 /**
  * builds a same game config object given a path to a .toml file
  *
@@ -37,73 +51,296 @@ config get_config_from_toml(std::string toml_file_path) {
   return cfg;
 }
 
-class game;
+/**
+ * fills an array with pseudo-random 64 bit keys using splitmix64. this runs
+ * at compile time so that zobrist hashes are the same from run to run.
+ *
+ * @param seed the initial state of the generator
+ * @return an array of N pseudo-random keys
+ */
+template <std::size_t N>
+constexpr std::array<std::uint64_t, N> make_zobrist_keys(std::uint64_t seed) {
+  std::array<std::uint64_t, N> keys{};
+  for (std::size_t i = 0; i < N; i++) {
+    seed += 0x9e3779b97f4a7c15;
+    std::uint64_t z = seed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    keys[i] = z ^ (z >> 31);
+  }
+  return keys;
+}
+
+/**
+ * A board position packed into a single byte, with four bits each for the
+ * column and the row. Moves in same game are the positions of the tiles to
+ * remove, so this is what basic_game uses as its move_type.
+ */
+class position {
+  private:
+    std::uint8_t code_;
+  public:
+    position() = default;
+
+    constexpr position(int col, int row) noexcept
+      : code_(static_cast<std::uint8_t>(col << 4 | row))
+    {}
+
+    constexpr int col() const noexcept {
+      return code_ >> 4;
+    }
+
+    constexpr int row() const noexcept {
+      return code_ & 0xF;
+    }
+
+    /**
+     * gets the packed representation of the position, which is unique per
+     * position and lies in [0, 256)
+     *
+     * @return the one byte code of the position
+     */
+    constexpr std::uint8_t code() const noexcept {
+      return code_;
+    }
+
+    friend constexpr bool operator==(position lhs, position rhs) noexcept {
+      return lhs.code_ == rhs.code_;
+    }
+
+    friend constexpr bool operator!=(position lhs, position rhs) noexcept {
+      return lhs.code_ != rhs.code_;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, position pos) {
+      return os << "{" << pos.col() << ", " << pos.row() << "}";
+    }
+};
+
+/**
+ * the board dimension used by basic_game to mean "read from the config at
+ * runtime" rather than fixed at compile time
+ */
+constexpr int dynamic_size = 0;
+
 /**
  * exposes internals of same game instances for testing purposes
  */
+template <class Game>
 class game_exposer {
   private:
-    game& game_;
+    Game& game_;
   public:
-    game_exposer(game& game)
+    game_exposer(Game& game)
       : game_(game)
     {}
+
+    int get_label(int col, int row) const {
+      return game_.label_map_[game_.index(col, row)];
+    }
+
+    int get_group_size(int label) const {
+      return game_.group_sizes_[label];
+    }
+
+    /**
+     * finds every chain on the board again from scratch, as the constructor does
+     */
+    void relabel() {
+      game_.find_available_moves();
+    }
 };
 
-class game {
+template <int Width = dynamic_size, int Height = dynamic_size>
+class basic_game;
+
+/**
+ * plays a same game out in place by removing uniformly random chains until
+ * none are left. This is the fast path used for rollouts: chains are sampled
+ * straight from the game's labels and the board's hash is only brought up to
+ * date once the playout is over, rather than after every move.
+ *
+ * @param state the game to play out, which is left in its final state
+ * @param rng the random bit generator used to pick chains
+ * @param on_move called with each move in the order they are taken
+ * @return the final cumulative reward and the number of moves taken
+ */
+template <int Width, int Height, class URBG, class MoveSink>
+playout_result random_playout(basic_game<Width, Height>& state, URBG& rng, MoveSink&& on_move);
+
+/**
+ * A same game state. When Width and Height are given the board dimensions are
+ * compile-time constants, so loops over the board have fixed trip counts and
+ * the board array is sized exactly. With the default dynamic_size dimensions
+ * the width and height come from the config instead and the board has room
+ * for up to 16x16 tiles (see the game alias below).
+ */
+template <int Width, int Height>
+class basic_game {
   public:
-    using move_type = std::pair<int, int>;
+    using move_type = position;
+    static constexpr bool is_dynamic = Width == dynamic_size || Height == dynamic_size;
+    static constexpr int max_width = is_dynamic ? 16 : Width;
+    static constexpr int max_height = is_dynamic ? 16 : Height;
+    static constexpr int num_tile_values = 8;
+    static_assert(max_width <= 32, "dirty columns are tracked in a 32 bit mask");
+    static_assert(max_width * max_height <= 256, "board offsets must fit in a byte");
+    static_assert(max_width <= 16 && max_height <= 16, "positions pack into a byte");
+    /**
+     * every chain covers at least two tiles, so there are never more moves
+     * than half the number of cells
+     */
+    using move_list_type = static_vector<move_type, max_width * max_height / 2>;
+    /**
+     * the number of tiles of each color on the board, indexed by tile value.
+     * empty cells aren't counted, so entry 0 is always 0.
+     */
+    using color_counts_type = std::array<std::uint16_t, num_tile_values>;
   private:
-    using board_type = std::vector<std::vector<short>>;
-    config cfg_;
+    using tile_type = std::uint8_t;
+    /**
+     * the board is a flat, column-major array of tiles with a fixed stride of
+     * max_height per column, so copying a game copies a few hundred bytes
+     * rather than a vector of vectors. tile (col, row) lives at
+     * col * max_height + row. cells outside of the configured width/height
+     * are always 0.
+     */
+    using board_type = std::array<tile_type, max_width * max_height>;
+    using cell_list = std::array<std::uint8_t, max_width * max_height>;
+    /**
+     * every tile belonging to a chain of two or more tiles is labelled with the
+     * index of that chain's move in available_moves_. all other cells hold
+     * no_label. since each labelled chain covers at least two tiles, there are
+     * never more than half as many chains as cells.
+     */
+    using label_type = std::uint8_t;
+    using label_map_type = std::array<label_type, max_width * max_height>;
+    using group_sizes_type = std::array<std::uint16_t, max_width * max_height / 2>;
+    static constexpr label_type no_label = std::numeric_limits<label_type>::max();
+    static constexpr std::array<std::uint64_t, max_width * max_height * num_tile_values>
+      zobrist_keys_ = make_zobrist_keys<max_width * max_height * num_tile_values>(0x5a3e);
+    // interned (see intern in util.hpp) so that copying a game never copies the config
+    const config* cfg_;
     board_type board_;
     int num_moves_made_;
-    std::vector<move_type> available_moves_;
+    move_list_type available_moves_;
+    label_map_type label_map_;
+    group_sizes_type group_sizes_;
+    std::uint64_t hash_;
+    color_counts_type color_counts_;
     double cumulative_reward_;
-    friend game_exposer;
+    friend game_exposer<basic_game>;
+    template <int W, int H, class URBG, class MoveSink>
+    friend playout_result random_playout(basic_game<W, H>&, URBG&, MoveSink&&);
+
+    /**
+     * maps a board position to its offset in the flat board array
+     *
+     * @param col the column of the position
+     * @param row the row of the position
+     * @return the offset of the position in board_type
+     */
+    static constexpr int index(int col, int row) noexcept {
+      return col * max_height + row;
+    }
+
+    /**
+     * gets the width of the board, which is a constant unless the game is dynamic
+     *
+     * @return the number of columns on the board
+     */
+    constexpr int width() const noexcept {
+      if constexpr (is_dynamic) {
+        return cfg_->width;
+      } else {
+        return Width;
+      }
+    }
+
+    /**
+     * gets the height of the board, which is a constant unless the game is dynamic
+     *
+     * @return the number of rows on the board
+     */
+    constexpr int height() const noexcept {
+      if constexpr (is_dynamic) {
+        return cfg_->height;
+      } else {
+        return Height;
+      }
+    }
+
+    /**
+     * looks up the zobrist key for a tile sitting at a board offset. a board's
+     * hash is the xor of the keys of all of its non-empty tiles.
+     *
+     * @param pos the offset of the tile in the flat board array
+     * @param tile the value of the tile
+     * @return the key for tile at pos
+     */
+    static std::uint64_t zobrist_key(int pos, tile_type tile) noexcept {
+      return zobrist_keys_[pos * num_tile_values + tile];
+    }
 
     /**
      * reduces the board by moving 0's within a column to the top of
      * the column and by moving columns with only 0's to the right-most
-     * end of the board.
+     * end of the board. This works in place on board_ and only touches
+     * the columns which lost tiles: each of those is compacted in a single
+     * pass, and only if one of them ended up empty are the columns to its
+     * right shifted over, again in a single pass. Unless UpdateHash is false,
+     * hash_ is updated for every tile that moves.
      *
-     * @param board a copy of a board
-     * @return the copied board with collapsing applied
+     * @param dirty_cols a bitmask with bit i set if column i lost tiles
+     * @param first_col the left-most column which lost tiles
+     * @param last_col the right-most column which lost tiles
      */
-    static board_type collapse(board_type board) {
-      int col_sz = board[0].size();
-
-      for (board_type::size_type i = 0; i < board.size(); i++) {
-        int num_removed = 0;
-        for (auto it = board[i].begin(); it != board[i].end();) {
-          if (*it == 0) {
-            it = board[i].erase(it);
-            num_removed++;
-          } else {
-            ++it;
+    template <bool UpdateHash = true>
+    void collapse(std::uint32_t dirty_cols, int first_col, int last_col) noexcept {
+      bool emptied = false;
+      for (int col = first_col; col <= last_col; col++) {
+        if (!(dirty_cols & (1u << col))) {
+          continue;
+        }
+        tile_type* column = &board_[index(col, 0)];
+        int dst = 0;
+        for (int row = 0; row < height(); row++) {
+          tile_type tile = column[row];
+          if (tile != 0) {
+            if (dst != row) {
+              if constexpr (UpdateHash) {
+                hash_ ^= zobrist_key(index(col, row), tile) ^ zobrist_key(index(col, dst), tile);
+              }
+              column[dst] = tile;
+            }
+            dst++;
           }
         }
-        board[i].insert(board[i].end(), num_removed, 0);
+        std::fill(column + dst, column + height(), 0);
+        emptied |= dst == 0;
       }
 
-      int vectors_removed = 0;
-      bool have_seen_non_empty = false;
-      for (auto it = board.rbegin(); it != board.rend();) {
-        bool is_all_zero = std::all_of(it->begin(), it->end(), [](short i) { return i==0; });
-        if (is_all_zero) {
-          if (have_seen_non_empty) {
-            it = static_cast<decltype(it)>(board.erase(std::next(it).base()));
-            vectors_removed++;
-            continue;
+      if (!emptied) {
+        return;
+      }
+
+      int dst_col = first_col;
+      for (int col = first_col; col < width(); col++) {
+        if (board_[index(col, 0)] == 0) {
+          continue;
+        }
+        if (dst_col != col) {
+          if constexpr (UpdateHash) {
+            for (int row = 0; row < height() && board_[index(col, row)] != 0; row++) {
+              tile_type tile = board_[index(col, row)];
+              hash_ ^= zobrist_key(index(col, row), tile) ^ zobrist_key(index(dst_col, row), tile);
+            }
           }
-        } else {
-          have_seen_non_empty = true;
+          std::copy_n(&board_[index(col, 0)], height(), &board_[index(dst_col, 0)]);
         }
-        ++it;
+        dst_col++;
       }
-
-      board.insert(board.end(), vectors_removed, std::vector<short>(col_sz, 0));
-      return board;
+      std::fill(&board_[index(dst_col, 0)], &board_[index(width(), 0)], 0);
     }
 
     /**
@@ -113,92 +350,92 @@ class game {
      *   2) collapses the board to move zero'd tiles
      *   3) determines a reward for the move
      *
-     * @param board a copy of a board
+     * The chain is cleared in place by looking up the selected tile's label in
+     * label_map_, so this must be called before the board is relabelled. While
+     * doing so it also works out which chains the move may have disturbed: any
+     * chain with a tile in a column at or right of the removed chain's first
+     * column, plus any chain in the column just left of it which now borders a
+     * same-colored tile. Chains whose moves lie left of all of these are
+     * untouched and keep their labels. hash_ is left stale if UpdateHash is false.
+     *
      * @param move the selected tile to remove
-     * @return a pair consisting of the board with the move applied as well as the a double
-     * holding the score of the move
+     * @param relabel_col set to the left-most column which needs relabelling
+     * @return the score of the move
      */
-    static std::pair<board_type, double> transform_board(board_type board, move_type move) {
-      std::set<move_type> adj = get_color_adjacent_tiles(board, move);
-      for (auto& m : adj) {
-        board[m.first][m.second] = 0;
+    template <bool UpdateHash = true>
+    double transform_board(move_type move, int& relabel_col) noexcept {
+      label_type label = label_map_[index(move.col(), move.row())];
+      assert(label != no_label);
+      std::uint32_t dirty_cols = 0;
+      // a chain's move is its left-most tile, so nothing left of it can carry its label
+      int first_col = available_moves_[label].col();
+      int last_col = first_col;
+      // labels are handed out in move order, so the smallest label seen belongs to
+      // the disturbed chain with the left-most move
+      label_type min_label = label;
+      color_counts_[board_[index(move.col(), move.row())]] -= group_sizes_[label];
+      for (int col = first_col; col < width(); col++) {
+        for (int row = 0; row < height(); row++) {
+          int pos = index(col, row);
+          min_label = std::min(min_label, label_map_[pos]);
+          if (label_map_[pos] == label) {
+            if constexpr (UpdateHash) {
+              hash_ ^= zobrist_key(pos, board_[pos]);
+            }
+            board_[pos] = 0;
+            dirty_cols |= 1u << col;
+            last_col = col;
+          }
+        }
       }
-      double move_reward = std::pow(adj.size() - 2, 2);
-      return std::make_pair(collapse(board), move_reward);
-    }
+      collapse<UpdateHash>(dirty_cols, first_col, last_col);
+      relabel_col = first_col;
 
-    /**
-     * determines if a board position (move position) is in bounds of the board. that is,
-     * it makes sure if the position is on the grid.
-     *
-     * @param board a const reference to a board instance
-     * @param move the position to be checked on the board
-     * @return true if the move is valid, false otherwise
-     */
-    static bool is_valid_position(const board_type& board, move_type move) noexcept {
-      return move.first >= 0 && move.first < static_cast<int>(board.size())
-        && move.second >= 0 && move.second < static_cast<int>(board[0].size());
-    }
-
-    /**
-     * retrieves the board value at a given position
-     *
-     * @param board a const reference to a board instance
-     * @param move a board position with which to retrieve a value
-     */
-    static short get_value(const board_type& board, move_type move) noexcept {
-      return board[move.first][move.second];
+      if (first_col > 0) {
+        for (int row = 0; row < height(); row++) {
+          int pos = index(first_col - 1, row);
+          if (board_[pos] == 0) {
+            break;
+          }
+          if (board_[pos] == board_[pos + max_height]) {
+            if (label_map_[pos] == no_label) {
+              relabel_col = first_col - 1;
+            } else {
+              min_label = std::min(min_label, label_map_[pos]);
+            }
+          }
+        }
+      }
+      relabel_col = std::min(relabel_col, available_moves_[min_label].col());
+      return std::pow(group_sizes_[label] - 2, 2);
     }
 
-
     /**
-     * This is a helper function for finding the set of contiguous same-colored tiles
-     * starting from a given board position. If the passed board position has the correct
-     * target value, we recurse up, right, down, and left on the board and check if they
-     * also have the corrrect target value. To avoid visiting the same position more than
-     * once with this recursion, we pass around a reference to a visited tile set which
-     * keeps track of where the algorithm has already been.
-     *
-     * @param board a const reference to a board instance
-     * @param move a position on the board to check
-     * @param target_value the color which we are interested in matching with
-     * @param adj a reference to the set of color adjacent tiles we are building
-     * @param visited a reference to the set of tiles where we have already been
+     * recomputes hash_ from scratch from the tiles on the board
      */
-    static void get_color_adjacent_tiles(const board_type& board, move_type move,
-        short target_value, std::set<move_type>& adj, std::set<move_type>& visited) {
-      if (visited.find(move) == visited.end()) {
-        visited.insert(move);
-        if (is_valid_position(board, move) && get_value(board, move) == target_value) {
-          adj.insert(move);
-          move_type left(move.first, move.second - 1);
-          move_type right(move.first, move.second + 1);
-          move_type up(move.first + 1, move.second);
-          move_type down(move.first - 1, move.second);
-
-          get_color_adjacent_tiles(board, left, target_value, adj, visited);
-          get_color_adjacent_tiles(board, right, target_value, adj, visited);
-          get_color_adjacent_tiles(board, up, target_value, adj, visited);
-          get_color_adjacent_tiles(board, down, target_value, adj, visited);
+    void rehash() noexcept {
+      hash_ = 0;
+      for (int pos = 0; pos < static_cast<int>(board_.size()); pos++) {
+        if (board_[pos] != 0) {
+          hash_ ^= zobrist_key(pos, board_[pos]);
         }
       }
     }
 
     /**
-     * This function dispatches a series of recursive calls to find the set of tiles from
-     * (and including) the passed position, move, which form a chain of adjacent tiles sharing
-     * the same color as move.
+     * follows parent links up to the root of pos's set, halving the path
+     * along the way
      *
-     * @param board a const reference to a board instance
-     * @param move the position on the board to find the color adjacent set from
-     * @return a set representing the chain of color adjacent tiles starting from (and including)
-     * the passed position, move.
+     * @param parent a reference to the union-find parent array
+     * @param pos the offset of a tile on the board
+     * @return the offset of the root of pos's set
      */
-    static std::set<move_type> get_color_adjacent_tiles(const board_type& board, move_type move) {
-      std::set<move_type> adj;
-      std::set<move_type> visited;
-      get_color_adjacent_tiles(board, move, get_value(board, move), adj, visited);
-      return adj;
+    static int find_root(cell_list& parent, int pos) noexcept {
+      while (parent[pos] != pos) {
+        parent[pos] = parent[parent[pos]];
+        pos = parent[pos];
+      }
+      return pos;
     }
 
     /**
@@ -211,58 +448,98 @@ class game {
      * all have the same consequence when taken, thus greatly reducing the branching factor
      * of the game.
      *
-     * @param a const reference to a board instance
-     * @return a vector of available moves which can be made on the passed board
+     * Chains are found with a two-pass union-find labelling. The first pass scans the
+     * board column-major, joining each tile with its same-colored left and lower
+     * neighbours; sets are always rooted at their smallest offset, which is the chain's
+     * left-most, down-most tile. The second pass resolves every tile to its root and
+     * fills available_moves_, label_map_ and group_sizes_ in move order.
+     *
+     * After a move only the chains from first_col onwards need to be found again (see
+     * transform_board). Chains whose move lies left of first_col keep their labels,
+     * which form a prefix of available_moves_; their tiles are skipped by the scan.
+     *
+     * @param first_col the left-most column whose chains need to be found
      */
-    static std::vector<move_type> find_available_moves(const board_type& board) {
-      std::vector<std::set<move_type>> adj_sets;
-      std::set<move_type> covered;
-      std::vector<move_type> moves;
-
-      for (board_type::size_type i = 0; i < board.size(); i++) {
-        for (board_type::size_type j = 0; j < board[i].size(); j++) {
-          move_type pos(i, j);
-          if (get_value(board, pos) == 0) {
+    void find_available_moves(int first_col = 0) {
+      cell_list parent;
+      std::array<std::uint16_t, max_width * max_height> size;
+
+      int keep = 0;
+      while (keep < static_cast<int>(available_moves_.size())
+          && available_moves_[keep].col() < first_col) {
+        keep++;
+      }
+      available_moves_.resize(keep);
+
+      auto join = [&](int a, int b) {
+        a = find_root(parent, a);
+        b = find_root(parent, b);
+        if (a != b) {
+          if (b < a) {
+            std::swap(a, b);
+          }
+          parent[b] = a;
+          size[a] += size[b];
+        }
+      };
+
+      int used_width = first_col;
+      for (int i = first_col; i < width() && board_[index(i, 0)] != 0; i++, used_width++) {
+        for (int j = 0; j < height(); j++) {
+          int pos = index(i, j);
+          tile_type tile = board_[pos];
+          if (tile == 0) {
             break;
           }
-          if (covered.find(pos) == covered.end()) {
-            std::set<move_type> adj = get_color_adjacent_tiles(board, pos);
-            if (adj.size() > 1) {
-              adj_sets.push_back(adj);
-              covered.insert(adj.begin(), adj.end());
-            }
+          if (label_map_[pos] < keep) {
+            continue;
+          }
+          parent[pos] = pos;
+          size[pos] = 1;
+          if (i > first_col && board_[pos - max_height] == tile) {
+            join(pos - max_height, pos);
+          }
+          if (j > 0 && board_[pos - 1] == tile) {
+            join(pos - 1, pos);
           }
         }
       }
 
-      for (auto& s : adj_sets) {
-        moves.push_back(*(s.begin()));
+      std::fill(&label_map_[index(used_width, 0)], &label_map_[index(width(), 0)], no_label);
+      for (int i = first_col; i < used_width; i++) {
+        for (int j = 0; j < height(); j++) {
+          int pos = index(i, j);
+          if (board_[pos] == 0) {
+            std::fill(&label_map_[pos], &label_map_[index(i + 1, 0)], no_label);
+            break;
+          }
+          if (label_map_[pos] < keep) {
+            continue;
+          }
+          int root = find_root(parent, pos);
+          if (size[root] < 2) {
+            label_map_[pos] = no_label;
+          } else if (root == pos) {
+            label_map_[pos] = available_moves_.size();
+            group_sizes_[label_map_[pos]] = size[root];
+            available_moves_.push_back(move_type(i, j));
+          } else {
+            label_map_[pos] = label_map_[root];
+          }
+        }
       }
-      return moves;
     }
 
     /**
      * This function should only be called when the game is essentially over, i.e,
      * there are no more possible moves to be taken. If the board has been cleared,
      * the player is rewarded +1000 points. Otherwise, they are penalized based on
-     * the number of remaining tiles on the board.
+     * the number of remaining tiles on the board, which comes from color_counts_.
      *
-     * @param board a const reference to a board instance
      * @return the end of game penalty/reward for the player as a double
      */
-    static double get_final_score(const board_type& board) {
-      int width = board.size();
-      int height = board[0].size();
-
-      int num_zeroes = 0;
-      for (int i = 0; i < width; i++) {
-        num_zeroes += std::count(board[i].begin(), board[i].end(), 0);
-        if (num_zeroes == height) {
-          break;
-        }
-      }
-
-      int tiles_remaining = width * height - num_zeroes;
+    double get_final_score() const noexcept {
+      int tiles_remaining = get_num_tiles();
       return tiles_remaining ? -std::pow(tiles_remaining - 2, 2) : 1000;
     }
 
@@ -273,69 +550,103 @@ class game {
      * @param other a board instance to base the new game on
      * @param move the move to be taken on a copy of the passed board instance
      */
-    game(const game& other, move_type move)
-      : cfg_(other.cfg_),
-        num_moves_made_(other.num_moves_made_ + 1)
+    basic_game(const basic_game& other, move_type move)
+      : basic_game(other)
     {
-      std::pair<board_type, double> move_result = transform_board(other.board_, move);
-      board_ = move_result.first;
-      cumulative_reward_ = other.cumulative_reward_ + move_result.second;
-      available_moves_ = find_available_moves(board_);
-      if (available_moves_.empty()) {
-        cumulative_reward_ += get_final_score(board_);
-      }
+      apply(move);
     }
 
   public:
     /**
-     * basic constructor for a game
+     * basic constructor for a game. throws std::invalid_argument if the board
+     * is bigger than max_width x max_height or the layout file doesn't fit it
      *
      * @param cfg a same game config instance
      */
-    game(config cfg)
-      : cfg_(cfg),
+    basic_game(config cfg)
+      : cfg_(intern(cfg)),
+        board_{},
         num_moves_made_(0),
         cumulative_reward_(0)
     {
+      assert(cfg_->width == width() && cfg_->height == height());
+      if (width() <= 0 || width() > max_width || height() <= 0 || height() > max_height) {
+        throw std::invalid_argument("same_game boards must be between 1x1 and "
+          + std::to_string(max_width) + "x" + std::to_string(max_height));
+      }
+      label_map_.fill(no_label);
 
-      for (int i = 0; i < cfg_.width; i++) {
-        std::vector<short> col;
-        for (int j = 0; j < cfg_.height; j++) {
-          short space_value = (std::rand() % 5) + 1;
-          col.push_back(space_value);
+      for (int i = 0; i < width(); i++) {
+        for (int j = 0; j < height(); j++) {
+          board_[index(i, j)] = (std::rand() % 5) + 1;
         }
-        board_.push_back(col);
       }
 
       if (cfg.board_layout_file != "") {
         std::ifstream layout(cfg.board_layout_file);
-        int j = cfg_.height - 1;
+        int j = height() - 1;
         for (std::string line; getline(layout, line);) {
           std::vector<std::string> elems = split(line, ' ');
+          if (j < 0 || elems.size() > static_cast<std::size_t>(width())) {
+            throw std::invalid_argument("board layout " + cfg.board_layout_file + " doesn't fit a "
+              + std::to_string(width()) + "x" + std::to_string(height()) + " board");
+          }
           for (int i = 0; i < elems.size(); i++) {
-            short value = static_cast<short>(elems[i][0] - 48);
-            board_[i][j] = value; 
+            int tile = elems[i].empty() ? -1 : elems[i][0] - '0';
+            if (tile < 0 || tile >= num_tile_values) {
+              throw std::invalid_argument("board layout " + cfg.board_layout_file + " has an invalid tile '"
+                + elems[i] + "'");
+            }
+            board_[index(i, j)] = static_cast<tile_type>(tile);
           }
           j--;
         }
       }
 
-      available_moves_ = find_available_moves(board_);
+      color_counts_.fill(0);
+      for (tile_type tile : board_) {
+        color_counts_[tile]++;
+      }
+      color_counts_[0] = 0;
+      rehash();
+      find_available_moves();
     }
 
     /**
      * writes the game state to standard out
      */
     void print() const {
-      for (int row = cfg_.height - 1; row >= 0; row--) {
-        for (int col = 0; col < cfg_.width; col++) {
-          short value = board_[col][row];
+      for (int row = height() - 1; row >= 0; row--) {
+        for (int col = 0; col < width(); col++) {
+          int value = board_[index(col, row)];
           std::cout << "\033[9" << (value == 0 ? 8 : value) << "m" << value << "\033[0m ";
         }
         std::cout << std::endl;
       }
     }
 
+    /**
+     * gets the tile at a board position
+     *
+     * @param col the column of the position
+     * @param row the row of the position
+     * @return the color of the tile, or 0 if the position is empty
+     */
+    int get_tile(int col, int row) const noexcept {
+      return board_[index(col, row)];
+    }
+
+    /**
+     * gets a code for a move together with its context, the color of the
+     * chain it removes, for learning move policies (see mcts::nrpa)
+     *
+     * @param move an available move
+     * @return the code of the move, which is below 256 * num_tile_values
+     */
+    std::uint32_t move_code(position move) const noexcept {
+      return move.code() | static_cast<std::uint32_t>(get_tile(move.col(), move.row())) << 8;
+    }
+
     /**
      * gets the number of moves which have occurred so far in this game.
      *
@@ -346,11 +657,11 @@ class game {
     }
 
     /**
-     * Getter for the vector of available moves which may be taken in this game
+     * Getter for the list of available moves which may be taken in this game
      *
-     * @return the vector of available moves
+     * @return a const reference to the inline list of available moves
      */
-    std::vector<move_type> get_available_moves() const noexcept {
+    const move_list_type& get_available_moves() const noexcept {
       return available_moves_;
     }
 
@@ -362,6 +673,67 @@ class game {
       return !available_moves_.empty();
     }
 
+    /**
+     * gets the number of tiles of each color left on the board. these are kept
+     * up to date as chains are removed.
+     *
+     * @return a const reference to the tile counts, indexed by tile value
+     */
+    const color_counts_type& get_color_counts() const noexcept {
+      return color_counts_;
+    }
+
+    /**
+     * gets the number of tiles left on the board
+     *
+     * @return the number of non-empty cells
+     */
+    int get_num_tiles() const noexcept {
+      int num_tiles = 0;
+      for (int count : color_counts_) {
+        num_tiles += count;
+      }
+      return num_tiles;
+    }
+
+    /**
+     * gives an upper bound on the reward which can still be gained from this
+     * state, which is never less than the best achievable, so searches may
+     * prune states whose cumulative reward plus this bound can't beat their
+     * best score. removing chains of one color scores at most as much as
+     * removing all n tiles of that color at once, (n - 2)^2, and the +1000
+     * bonus is only possible if no color is down to a single tile. any other
+     * end of game penalty is at most 0.
+     *
+     * @return an upper bound on the reward left to gain
+     */
+    double get_score_upper_bound() const noexcept {
+      if (available_moves_.empty()) {
+        return 0;
+      }
+      double bound = 0;
+      bool clearable = true;
+      for (int count : color_counts_) {
+        if (count >= 2) {
+          bound += (count - 2) * (count - 2);
+        }
+        clearable &= count != 1;
+      }
+      return clearable ? bound + 1000 : bound;
+    }
+
+    /**
+     * gets the zobrist hash of the board. the hash depends only on which tiles
+     * are where, so games which reach the same board through different
+     * sequences of moves hash equally. it is kept up to date as moves are
+     * made rather than recomputed.
+     *
+     * @return a 64 bit hash of the board
+     */
+    std::uint64_t hash() const noexcept {
+      return hash_;
+    }
+
     /**
      * getter for the cumulative reward of this game. returns the sum of
      * rewards for all moves taken thus far in the game.
@@ -379,9 +751,86 @@ class game {
      * @param move the move to be taken on the current state
      * @return a newly constructed game instance
      */
-    game make_move(move_type move) const {
-      return game(*this, move);
+    basic_game make_move(move_type move) const {
+      return basic_game(*this, move);
+    }
+
+    /**
+     * Takes a move on the current game state in place. Unlike make_move this
+     * never allocates, since the board, labels and move list are all reused.
+     *
+     * @param move the move to be taken on the current state
+     */
+    void apply(move_type move) {
+      int relabel_col;
+      num_moves_made_++;
+      cumulative_reward_ += transform_board(move, relabel_col);
+      find_available_moves(relabel_col);
+      if (available_moves_.empty()) {
+        cumulative_reward_ += get_final_score();
+      }
     }
 };
 
+template <int Width, int Height, class URBG, class MoveSink>
+playout_result random_playout(basic_game<Width, Height>& state, URBG& rng, MoveSink&& on_move) {
+  auto& moves = state.available_moves_;
+  int num_moves = 0;
+  while (!moves.empty()) {
+    auto move = moves[rng() % moves.size()];
+    int relabel_col;
+    state.cumulative_reward_ += state.template transform_board<false>(move, relabel_col);
+    state.find_available_moves(relabel_col);
+    on_move(move);
+    num_moves++;
+  }
+  if (num_moves > 0) {
+    state.num_moves_made_ += num_moves;
+    state.cumulative_reward_ += state.get_final_score();
+    state.rehash();
+  }
+  return {state.cumulative_reward_, num_moves};
+}
+
+/**
+ * plays a same game out in place by removing uniformly random chains until
+ * none are left
+ *
+ * @param state the game to play out, which is left in its final state
+ * @param rng the random bit generator used to pick chains
+ * @return the final cumulative reward and the number of moves taken
+ */
+template <int Width, int Height, class URBG>
+playout_result random_playout(basic_game<Width, Height>& state, URBG& rng) {
+  return random_playout(state, rng, [](position) {});
+}
+
+static_assert(std::is_trivially_copyable_v<basic_game<>>,
+    "games are copied into every tree node and playout, so copies should be plain memcpys");
+
+/**
+ * the runtime-sized same game, which can play on any board which fits in 16x16
+ */
+using game = basic_game<>;
+
+/**
+ * Constructs a game from a config and hands it to f. Boards with one of the
+ * dimensions we specialize for (15x15 and 10x10) get a fixed-size basic_game,
+ * and everything else falls back to the runtime-sized game. f is typically a
+ * generic lambda, so it is instantiated once per game type.
+ *
+ * @param cfg a same game config instance
+ * @param f a callable accepting any basic_game by value
+ */
+template <class F>
+void dispatch_game(const config& cfg, F&& f) {
+  if (cfg.width == 15 && cfg.height == 15) {
+    f(basic_game<15, 15>(cfg));
+  } else if (cfg.width == 10 && cfg.height == 10) {
+    f(basic_game<10, 10>(cfg));
+  } else {
+    f(game(cfg));
+  }
+}
+
 }
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "byte_lanes.hpp"
+#include "same_game.hpp"
+
+namespace same_game
+{
+
+/**
+ * Plays Lanes copies of a same game out at once, in lockstep. The boards are
+ * stored as a structure of arrays: each board cell holds one byte per lane,
+ * so every step of the playout (finding chains, removing one chain per board
+ * and collapsing the boards) is done for all lanes with the same byte_lanes
+ * operations. Each lane removes a uniformly random chain per step, just like
+ * random_playout, and lanes which run out of moves sit idle until the last
+ * one finishes.
+ *
+ * Chains are found by propagating the smallest cell offset through same-colored
+ * neighbours until nothing changes, so each chain ends up labelled with the
+ * offset of its left-most, down-most tile, which is also its move.
+ */
+template <class Game, int Lanes = 32>
+class playout_batch {
+  public:
+    using move_type = typename Game::move_type;
+    static_assert(Lanes > 0 && Lanes <= 128, "chain and move counts are kept in bytes");
+  private:
+    using lanes = byte_lanes<Lanes>;
+    static constexpr int max_width = Game::max_width;
+    static constexpr int max_height = Game::max_height;
+    static constexpr int num_cells = max_width * max_height;
+    using cell_lanes = std::array<lanes, num_cells>;
+    cell_lanes tiles_;
+    cell_lanes labels_;
+    // 0xFF in the lanes where a cell isn't joined to the cell above/right of it
+    cell_lanes split_up_;
+    cell_lanes split_right_;
+    cell_lanes roots_;
+    std::array<double, Lanes> rewards_;
+    std::array<int, Lanes> num_moves_;
+
+    static constexpr int index(int col, int row) noexcept {
+      return col * max_height + row;
+    }
+
+    /**
+     * labels every chain on every board and marks each chain's root, i.e. the
+     * cell whose offset is the chain's label. Only chains of two or more tiles
+     * get roots.
+     *
+     * @return the number of chains on each board
+     */
+    lanes label_chains() noexcept {
+      const lanes zero = lanes::splat(0);
+      const lanes split = lanes::splat(0xFF);
+      for (int col = 0; col < max_width; col++) {
+        for (int row = 0; row < max_height; row++) {
+          int pos = index(col, row);
+          lanes tile = tiles_[pos];
+          lanes empty = eq(tile, zero);
+          split_up_[pos] = row + 1 < max_height ? empty | ~eq(tile, tiles_[pos + 1]) : split;
+          split_right_[pos] = col + 1 < max_width ? empty | ~eq(tile, tiles_[pos + max_height]) : split;
+          labels_[pos] = lanes::splat(pos);
+        }
+      }
+
+      // alternate forward and backward sweeps until the labels settle. a split
+      // mask turns the neighbour's label into 0xFF so that min() ignores it.
+      lanes changed;
+      do {
+        changed = zero;
+        for (int col = 0; col < max_width; col++) {
+          for (int row = 0; row < max_height; row++) {
+            int pos = index(col, row);
+            lanes label = labels_[pos];
+            if (row > 0) {
+              label = min(label, labels_[pos - 1] | split_up_[pos - 1]);
+            }
+            if (col > 0) {
+              label = min(label, labels_[pos - max_height] | split_right_[pos - max_height]);
+            }
+            changed = changed | ~eq(label, labels_[pos]);
+            labels_[pos] = label;
+          }
+        }
+        for (int col = max_width - 1; col >= 0; col--) {
+          for (int row = max_height - 1; row >= 0; row--) {
+            int pos = index(col, row);
+            lanes label = labels_[pos];
+            if (row + 1 < max_height) {
+              label = min(label, labels_[pos + 1] | split_up_[pos]);
+            }
+            if (col + 1 < max_width) {
+              label = min(label, labels_[pos + max_height] | split_right_[pos]);
+            }
+            changed = changed | ~eq(label, labels_[pos]);
+            labels_[pos] = label;
+          }
+        }
+      } while (any(changed));
+
+      const lanes one = lanes::splat(1);
+      lanes num_chains = zero;
+      for (int col = 0; col < max_width; col++) {
+        for (int row = 0; row < max_height; row++) {
+          int pos = index(col, row);
+          lanes alone = split_up_[pos] & split_right_[pos];
+          if (row > 0) {
+            alone = alone & split_up_[pos - 1];
+          }
+          if (col > 0) {
+            alone = alone & split_right_[pos - max_height];
+          }
+          roots_[pos] = andnot(alone, eq(labels_[pos], lanes::splat(pos)));
+          num_chains = num_chains + (roots_[pos] & one);
+        }
+      }
+      return num_chains;
+    }
+
+    /**
+     * picks a uniformly random chain on every board with chains left
+     *
+     * @param num_chains the number of chains on each board
+     * @param rng the random bit generator used to pick chains
+     * @return the label of the picked chain on each board
+     */
+    template <class URBG>
+    lanes pick_chains(lanes num_chains, URBG& rng) {
+      alignas(32) std::array<std::uint8_t, Lanes> counts;
+      alignas(32) std::array<std::uint8_t, Lanes> targets;
+      num_chains.store(counts.data());
+      for (int i = 0; i < Lanes; i++) {
+        // the running count of roots below never reaches 0xFF, so idle lanes pick nothing
+        targets[i] = counts[i] ? rng() % counts[i] : 0xFF;
+      }
+
+      const lanes one = lanes::splat(1);
+      const lanes target = lanes::load(targets.data());
+      lanes seen = lanes::splat(0);
+      lanes picked = lanes::splat(0);
+      for (int pos = 0; pos < num_cells; pos++) {
+        picked = blend(picked, lanes::splat(pos), roots_[pos] & eq(seen, target));
+        seen = seen + (roots_[pos] & one);
+      }
+      return picked;
+    }
+
+    /**
+     * removes the picked chains and scores the moves
+     *
+     * @param picked the label of the chain to remove on each board
+     * @param active 0xFF on the boards which have a chain to remove
+     * @return a bitmask with bit i set if column i lost tiles on any board
+     */
+    std::uint32_t remove_chains(lanes picked, lanes active) noexcept {
+      const lanes one = lanes::splat(1);
+      // sizes are counted separately for each half of the board so that neither
+      // count can overflow a byte, even when one chain covers a whole 16x16 board
+      std::array<lanes, 2> sizes = {lanes::splat(0), lanes::splat(0)};
+      std::uint32_t dirty_cols = 0;
+      for (int col = 0; col < max_width; col++) {
+        lanes removed = lanes::splat(0);
+        for (int row = 0; row < max_height; row++) {
+          int pos = index(col, row);
+          lanes hit = eq(labels_[pos], picked) & active;
+          tiles_[pos] = andnot(hit, tiles_[pos]);
+          sizes[pos >= num_cells / 2] = sizes[pos >= num_cells / 2] + (hit & one);
+          removed = removed | hit;
+        }
+        if (any(removed)) {
+          dirty_cols |= 1u << col;
+        }
+      }
+
+      for (int i = 0; i < Lanes; i++) {
+        int size = sizes[0].lane(i) + sizes[1].lane(i);
+        if (size > 0) {
+          rewards_[i] += (size - 2) * (size - 2);
+          num_moves_[i]++;
+        }
+      }
+      return dirty_cols;
+    }
+
+    /**
+     * lets the tiles in each dirty column fall down into the gaps below them and
+     * then moves columns left over any columns which were emptied. every tile
+     * whose destination is d is gathered into d, which is how tiles in different
+     * lanes move by different distances.
+     *
+     * @param dirty_cols a bitmask with bit i set if column i lost tiles on any board
+     */
+    void collapse(std::uint32_t dirty_cols) noexcept {
+      const lanes zero = lanes::splat(0);
+      const lanes one = lanes::splat(1);
+      std::array<lanes, max_height> dst_row;
+      for (int col = 0; col < max_width; col++) {
+        if (!(dirty_cols & (1u << col))) {
+          continue;
+        }
+        lanes gaps = zero;
+        for (int row = 0; row < max_height; row++) {
+          dst_row[row] = lanes::splat(row) - gaps;
+          gaps = gaps + (eq(tiles_[index(col, row)], zero) & one);
+        }
+        for (int dst = 0; dst < max_height; dst++) {
+          lanes tile = zero;
+          for (int row = dst; row < max_height; row++) {
+            tile = tile | (tiles_[index(col, row)] & eq(dst_row[row], lanes::splat(dst)));
+          }
+          tiles_[index(col, dst)] = tile;
+        }
+      }
+
+      std::array<lanes, max_width> dst_col;
+      lanes gaps = zero;
+      lanes moved = zero;
+      int first_empty = max_width;
+      for (int col = 0; col < max_width; col++) {
+        dst_col[col] = lanes::splat(col) - gaps;
+        lanes empty = eq(tiles_[index(col, 0)], zero);
+        moved = moved | andnot(empty, ~eq(gaps, zero));
+        if (first_empty == max_width && any(empty)) {
+          first_empty = col;
+        }
+        gaps = gaps + (empty & one);
+      }
+      if (!any(moved)) {
+        return;
+      }
+      for (int dst = first_empty; dst < max_width; dst++) {
+        std::array<lanes, max_height> column;
+        column.fill(zero);
+        for (int col = dst; col < max_width; col++) {
+          lanes moves_here = eq(dst_col[col], lanes::splat(dst));
+          for (int row = 0; row < max_height; row++) {
+            column[row] = column[row] | (tiles_[index(col, row)] & moves_here);
+          }
+        }
+        std::copy(column.begin(), column.end(), &tiles_[index(dst, 0)]);
+      }
+    }
+
+  public:
+    /**
+     * plays Lanes copies of state out by removing uniformly random chains
+     * until none are left on any board
+     *
+     * @param state the game to play out
+     * @param rng the random bit generator used to pick chains
+     * @param on_move called with the lane and the move each time a lane takes a move
+     */
+    template <class URBG, class LaneMoveSink>
+    void play_out(const Game& state, URBG& rng, LaneMoveSink&& on_move) {
+      for (int col = 0; col < max_width; col++) {
+        for (int row = 0; row < max_height; row++) {
+          tiles_[index(col, row)] = lanes::splat(state.get_tile(col, row));
+        }
+      }
+      rewards_.fill(state.get_cumulative_reward());
+      num_moves_.fill(0);
+
+      const lanes zero = lanes::splat(0);
+      for (lanes num_chains = label_chains(); any(num_chains); num_chains = label_chains()) {
+        lanes picked = pick_chains(num_chains, rng);
+        lanes active = ~eq(num_chains, zero);
+        for (int i = 0; i < Lanes; i++) {
+          if (active.lane(i)) {
+            on_move(i, move_type(picked.lane(i) / max_height, picked.lane(i) % max_height));
+          }
+        }
+        collapse(remove_chains(picked, active));
+      }
+
+      for (int i = 0; i < Lanes; i++) {
+        if (num_moves_[i] == 0) {
+          continue;
+        }
+        int tiles_remaining = 0;
+        for (int pos = 0; pos < num_cells; pos++) {
+          tiles_remaining += tiles_[pos].lane(i) != 0;
+        }
+        rewards_[i] += tiles_remaining ? -(tiles_remaining - 2) * (tiles_remaining - 2) : 1000;
+      }
+    }
+
+    /**
+     * getter for the final rewards of the most recent play_out
+     *
+     * @return the final cumulative reward of each lane
+     */
+    const std::array<double, Lanes>& get_rewards() const noexcept {
+      return rewards_;
+    }
+
+    /**
+     * getter for the number of moves taken in each lane by the most recent play_out
+     *
+     * @return the number of moves taken in each lane
+     */
+    const std::array<int, Lanes>& get_num_moves() const noexcept {
+      return num_moves_;
+    }
+};
+
+/**
+ * the widest batch random_playouts plays out at once. 32 lanes only pay for
+ * themselves when every byte_lanes operation is a single AVX2 instruction.
+ */
+#ifdef __AVX2__
+constexpr std::size_t max_batch_lanes = 32;
+#else
+constexpr std::size_t max_batch_lanes = 16;
+#endif
+
+/**
+ * plays n independent random playouts of a same game. They run in lockstep
+ * batches of max_batch_lanes boards (see playout_batch) while that many are
+ * left, then in a batch of 16 if at least 16 are. A batch costs about as much
+ * as its slowest lane, so fewer than 16 playouts are cheaper one at a time, and
+ * the rest run through random_playout.
+ *
+ * @param state the game to play out
+ * @param n the number of playouts
+ * @param rng the random bit generator used to pick chains
+ * @return the final cumulative reward of each playout
+ */
+template <int Width, int Height, class URBG>
+std::vector<double> random_playouts(const basic_game<Width, Height>& state, std::size_t n, URBG& rng) {
+  std::vector<double> rewards;
+  rewards.reserve(n);
+  auto play_batches = [&](auto lanes) {
+    constexpr std::size_t num_lanes = decltype(lanes)::value;
+    if (n - rewards.size() >= num_lanes) {
+      playout_batch<basic_game<Width, Height>, num_lanes> batch;
+      while (n - rewards.size() >= num_lanes) {
+        batch.play_out(state, rng, [](int, position) {});
+        rewards.insert(rewards.end(), batch.get_rewards().begin(), batch.get_rewards().end());
+      }
+    }
+  };
+  play_batches(std::integral_constant<std::size_t, max_batch_lanes>{});
+  play_batches(std::integral_constant<std::size_t, 16>{});
+  while (rewards.size() < n) {
+    basic_game<Width, Height> copy(state);
+    rewards.push_back(random_playout(copy, rng, [](position) {}).reward);
+  }
+  return rewards;
+}
+
+}
@@ -20,7 +20,7 @@ class node {
     {}
     
     void expand() {
-      std::vector<move_type> moves = game_.get_available_moves();
+      const auto& moves = game_.get_available_moves();
       for (auto& move : moves) {
         children_.push_back(node{game_.make_move(move)});
       }
@@ -34,7 +34,7 @@ class node {
       return children_;
     }
 
-    Game get_game() const {
+    const Game& get_game() const {
       return game_;
     }
 
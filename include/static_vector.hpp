@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+
+/**
+ * A vector-like container with a fixed capacity whose elements live inline,
+ * so it never allocates and copying it is a plain copy of its storage. It
+ * provides the subset of std::vector used for move lists: indexing, iteration,
+ * push_back, shrinking and clearing.
+ */
+template <class T, std::size_t N>
+class static_vector {
+  public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using iterator = T*;
+    using const_iterator = const T*;
+  private:
+    std::array<T, N> data_;
+    size_type size_;
+  public:
+    static_vector() noexcept
+      : size_(0)
+    {}
+
+    /**
+     * appends an element to the end of the vector. the vector must not
+     * already be at capacity.
+     *
+     * @param value the element to append
+     */
+    void push_back(const T& value) noexcept {
+      assert(size_ < N);
+      data_[size_++] = value;
+    }
+
+    /**
+     * drops elements from the end of the vector so that it holds at most
+     * size elements
+     *
+     * @param size the new size of the vector, which must not exceed the old one
+     */
+    void resize(size_type size) noexcept {
+      assert(size <= size_);
+      size_ = size;
+    }
+
+    void clear() noexcept {
+      size_ = 0;
+    }
+
+    size_type size() const noexcept {
+      return size_;
+    }
+
+    static constexpr size_type capacity() noexcept {
+      return N;
+    }
+
+    bool empty() const noexcept {
+      return size_ == 0;
+    }
+
+    T& operator[](size_type i) noexcept {
+      return data_[i];
+    }
+
+    const T& operator[](size_type i) const noexcept {
+      return data_[i];
+    }
+
+    T& front() noexcept {
+      return data_[0];
+    }
+
+    const T& front() const noexcept {
+      return data_[0];
+    }
+
+    iterator begin() noexcept {
+      return data_.data();
+    }
+
+    const_iterator begin() const noexcept {
+      return data_.data();
+    }
+
+    iterator end() noexcept {
+      return data_.data() + size_;
+    }
+
+    const_iterator end() const noexcept {
+      return data_.data() + size_;
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of threads for fork-join work. run(n, f) calls f(i) for every
+ * i in [0, n), spread over the pool's threads and the calling thread, and
+ * returns once every call has finished. The threads sleep between runs, so
+ * keeping a pool around is cheap and saves starting threads for every run.
+ */
+class thread_pool {
+  private:
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    // the current run. these are only written while every thread is asleep
+    std::function<void(std::size_t)> job_;
+    std::size_t job_size_;
+    std::atomic<std::size_t> next_;
+    // the number of threads which have finished the current run
+    std::size_t num_done_;
+    std::size_t generation_;
+    bool stopping_;
+
+    void work() {
+      for (std::size_t i = next_.fetch_add(1); i < job_size_; i = next_.fetch_add(1)) {
+        job_(i);
+      }
+    }
+
+    void loop() {
+      std::size_t seen = 0;
+      for (;;) {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+          if (stopping_) {
+            return;
+          }
+          seen = generation_;
+        }
+        work();
+        {
+          std::lock_guard<std::mutex> guard(mutex_);
+          num_done_++;
+        }
+        done_.notify_one();
+      }
+    }
+
+  public:
+    /**
+     * thread_pool constructor
+     *
+     * @param num_threads the number of threads to start, besides the ones
+     * which will call run
+     */
+    explicit thread_pool(std::size_t num_threads)
+      : job_size_(0),
+        next_(0),
+        num_done_(0),
+        generation_(0),
+        stopping_(false)
+    {
+      for (std::size_t i = 0; i < num_threads; i++) {
+        threads_.emplace_back([this] { loop(); });
+      }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stopping_ = true;
+      }
+      wake_.notify_all();
+      for (std::thread& t : threads_) {
+        t.join();
+      }
+    }
+
+    /**
+     * calls f(i) for every i in [0, n) on the pool's threads and this one,
+     * and waits for them all. only one thread may call run at a time.
+     *
+     * @param n the number of calls
+     * @param f the function to call
+     */
+    template <class F>
+    void run(std::size_t n, F&& f) {
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        job_ = std::ref(f);
+        job_size_ = n;
+        next_.store(0);
+        num_done_ = 0;
+        generation_++;
+      }
+      wake_.notify_all();
+      work();
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_.wait(lock, [this] { return num_done_ == threads_.size(); });
+      job_ = nullptr;
+    }
+};
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <deque>
 #include <iostream>
 #include <iterator>
+#include <mutex>
 #include <vector>
 #include <random>
 #include <sstream>
@@ -242,6 +245,29 @@ bool is_in_toml(const std::shared_ptr<cpptoml::table>& tbl, std::string prop) {
   return static_cast<bool>(opt);
 }
 
+/**
+ * Interns a value: returns a pointer to a single immutable copy of it which
+ * lives for the rest of the program, with equal values sharing one copy. Game
+ * states use this to refer to their config by pointer rather than each carrying
+ * a copy of it.
+ *
+ * @param value the value to intern, which must be equality comparable
+ * @return a pointer to the interned copy of value
+ */
+template <class T>
+const T* intern(const T& value) {
+  static std::mutex mutex;
+  // a deque never moves its elements when growing, so the pointers stay valid
+  static std::deque<T> interned;
+  std::lock_guard<std::mutex> guard(mutex);
+  auto it = std::find(interned.begin(), interned.end(), value);
+  if (it != interned.end()) {
+    return &*it;
+  }
+  interned.push_back(value);
+  return &interned.back();
+}
+
 template <class T>
 bool approx_equal(T lhs, T rhs, double tolerance = 1e-5) {
   double diff = std::abs(lhs - rhs);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include "cxxopts.hpp"
@@ -11,6 +12,8 @@ int main(int argc, char** argv) {
     ("c,cfg", "Path to game config", cxxopts::value<std::string>()
       ->default_value("../cfg/generic_game.toml"))
     ("n,num_iters", "Number of iterations to perform", cxxopts::value<int>()->default_value("1000"))
+    ("t,num_threads", "Number of threads searching the tree", cxxopts::value<int>()->default_value("1"))
+    ("leaf_playouts", "Playouts run at once from every new leaf", cxxopts::value<int>()->default_value("1"))
     ("s,sd_model_path", "Path to pytorch saved SD model", cxxopts::value<std::string>()->default_value("../models/sd_model.pt"))
     ("v,varphi_model_path", "Path to pytorch saved varphi model", cxxopts::value<std::string>()->default_value("../models/varphi_model.pt"))
     ("d,delta_model_path", "Path to pytorch saved delta model", cxxopts::value<std::string>()->default_value("../models/delta_model.pt"))
@@ -19,7 +22,11 @@ int main(int argc, char** argv) {
   auto result = options.parse(argc, argv);
 
   std::string cfg_toml_path = result["cfg"].as<std::string>();
-  int num_iters = result["num_iters"].as<int>();
+  mcts::uct_config uct_cfg;
+  uct_cfg.num_iterations = result["num_iters"].as<int>();
+  // keep negative counts from wrapping around; uct rejects 0
+  uct_cfg.num_threads = std::max(result["num_threads"].as<int>(), 0);
+  uct_cfg.leaf_playouts = std::max(result["leaf_playouts"].as<int>(), 0);
   std::string sd_model_path = result["sd_model_path"].as<std::string>();
   std::string varphi_model_path = result["varphi_model_path"].as<std::string>();
   std::string delta_model_path = result["delta_model_path"].as<std::string>();
@@ -28,8 +35,7 @@ int main(int argc, char** argv) {
 
   generic_game::game game(cfg, sd_model_path, varphi_model_path, delta_model_path);
 
-  mcts::node<generic_game::game> node(game);
-  mcts::uct uct(node, num_iters); 
+  mcts::uct uct(game, uct_cfg);
 
   uct.search();
 
@@ -1,8 +1,14 @@
+#include <ctime>
+#include <functional>
 #include <random>
+#include <thread>
 
 namespace random_engine
 {
 
-std::default_random_engine generator(time(0));
+// seeded with the thread id as well as the time so that threads started in
+// the same second don't draw the same numbers
+thread_local std::default_random_engine generator(
+  time(0) ^ std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
 }
\ No newline at end of file
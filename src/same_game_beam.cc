@@ -0,0 +1,46 @@
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+#include "beam_search.hpp"
+#include "cxxopts.hpp"
+#include "same_game.hpp"
+
+int main(int argc, char** argv) {
+  std::srand(std::time(0));
+
+  cxxopts::Options options("same_game_beam", "Performs beam search on samegame");
+  options.add_options()
+    ("c,cfg", "Path to game config", cxxopts::value<std::string>()
+      ->default_value("../cfg/same_game.toml"))
+    ("w,width", "Number of states kept at each depth", cxxopts::value<int>()->default_value("1000"))
+    ("t,num_threads", "Number of threads expanding states", cxxopts::value<int>()->default_value("1"))
+    ("bound_heuristic", "Rank states by their reward plus an upper bound on the reward left")
+    ("time_limit", "Seconds the search may take, or 0 for no limit", cxxopts::value<double>()->default_value("0"))
+  ;
+
+  auto result = options.parse(argc, argv);
+
+  std::string cfg_toml_path = result["cfg"].as<std::string>();
+  mcts::beam_config beam_cfg;
+  // negative values would wrap around to huge sizes; as 0 the search rejects them
+  beam_cfg.width = std::max(result["width"].as<int>(), 0);
+  beam_cfg.num_threads = std::max(result["num_threads"].as<int>(), 0);
+  beam_cfg.time_limit = result["time_limit"].as<double>();
+  bool bound_heuristic = result["bound_heuristic"].as<bool>();
+
+  same_game::config cfg = same_game::get_config_from_toml(cfg_toml_path);
+
+  same_game::dispatch_game(cfg, [&](auto game) {
+    using game_type = decltype(game);
+    typename mcts::beam_search<game_type>::heuristic_type heuristic;
+    if (bound_heuristic) {
+      heuristic = [](const game_type& state) { return state.get_score_upper_bound(); };
+    }
+    mcts::beam_search beam(game, beam_cfg, heuristic);
+
+    beam.search();
+  });
+
+  return 0;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include "cxxopts.hpp"
 #include "same_game.hpp"
@@ -14,35 +15,42 @@ int main(int argc, char** argv) {
 
   same_game::config cfg = same_game::get_config_from_toml(cfg_toml_path);
 
-  same_game::game game(cfg);
-  game.print();
-
-  auto moves = game.get_available_moves();
-  int prev_score = 0;
+  same_game::dispatch_game(cfg, [&](auto game) {
+    game.print();
 
-  while (!moves.empty()) {
-    std::cout << "Available moves: ";
-    for (auto& move : moves) {
-      std::cout << "(" << move.first << ", " << move.second << ") "; 
-    }
-    std::cout << "\n";
-    int x, y;
-    std::cin >> x >> y;
-    auto move = std::make_pair(x, y);
-    game = game.make_move(move);
-    int score = game.get_cumulative_reward() - prev_score;
-
-    if (score >= 0) {
-      std::cout << "Scored: " << score << " (" << (std::sqrt(score) + 2) << " tiles)\n";
-    } else {
-      std::cout << "Penalized: " << score << " (" << (std::sqrt(-score) + 2) << " tiles)\n";
+    auto moves = game.get_available_moves();
+    int prev_score = 0;
+
+    while (!moves.empty()) {
+      std::cout << "Available moves: ";
+      for (auto& move : moves) {
+        std::cout << "(" << move.col() << ", " << move.row() << ") "; 
+      }
+      std::cout << "\n";
+      int x, y;
+      if (!(std::cin >> x >> y)) {
+        break;
+      }
+      typename decltype(game)::move_type move(x, y);
+      if (std::find(moves.begin(), moves.end(), move) == moves.end()) {
+        std::cout << "Invalid move\n";
+        continue;
+      }
+      game = game.make_move(move);
+      int score = game.get_cumulative_reward() - prev_score;
+
+      if (score >= 0) {
+        std::cout << "Scored: " << score << " (" << (std::sqrt(score) + 2) << " tiles)\n";
+      } else {
+        std::cout << "Penalized: " << score << " (" << (std::sqrt(-score) + 2) << " tiles)\n";
+      }
+
+      std::cout << "Total: " << game.get_cumulative_reward() << "\n";
+      game.print();
+      moves = game.get_available_moves();
+      prev_score = game.get_cumulative_reward();
     }
-
-    std::cout << "Total: " << game.get_cumulative_reward() << "\n";
-    game.print();
-    moves = game.get_available_moves();
-    prev_score = game.get_cumulative_reward();
-  }
+  });
 
   return 0;
 }
@@ -3,7 +3,7 @@
 
 #include "cxxopts.hpp"
 #include "deep_tree_simulator.hpp"
-#include "same_game.hpp"
+#include "same_game_batch.hpp"
 
 int main(int argc, char** argv) {
   std::srand(std::time(0));
@@ -22,10 +22,10 @@ int main(int argc, char** argv) {
 
   same_game::config cfg = same_game::get_config_from_toml(cfg_toml_path);
 
-  same_game::game game(cfg);
-
-  simulator::deep_tree_simulator<same_game::game> sim(game, num_iters, "main.same_game.csv");
-  sim.simulate();
+  same_game::dispatch_game(cfg, [&](auto game) {
+    simulator::deep_tree_simulator<decltype(game)> sim(game, num_iters, "main.same_game.csv");
+    sim.simulate();
+  });
 
   return 0;
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 
@@ -12,22 +13,56 @@ int main(int argc, char** argv) {
   options.add_options()
     ("c,cfg", "Path to game config", cxxopts::value<std::string>()
       ->default_value("../cfg/same_game.toml"))
-    ("n,num_iters", "Number of iterations to perform", cxxopts::value<int>()->default_value("1000"))
+    ("n,num_iters", "Number of iterations to perform (0 for no limit)", cxxopts::value<int>()->default_value("1000"))
+    ("time_limit", "Seconds each search may take (0 for no limit)", cxxopts::value<double>()->default_value("0"))
+    ("k,checkpoint_interval", "Plies between tree nodes which keep their game state (0 keeps only the root's)",
+      cxxopts::value<int>()->default_value("1"))
+    ("t,num_threads", "Number of threads searching the tree", cxxopts::value<int>()->default_value("1"))
+    ("virtual_loss", "Reward taken off nodes on paths other threads are searching",
+      cxxopts::value<double>()->default_value("1"))
+    ("root_parallel", "Give every thread a tree of its own and merge their root statistics",
+      cxxopts::value<bool>()->default_value("false"))
+    ("sync_interval", "Iterations each tree runs between root statistics merges (0 merges at the end only)",
+      cxxopts::value<int>()->default_value("0"))
+    ("leaf_playouts", "Playouts run at once from every new leaf", cxxopts::value<int>()->default_value("1"))
+    ("transpositions", "Merge boards reached by different move orders into one node",
+      cxxopts::value<bool>()->default_value("false"))
+    ("play", "Play a whole game, searching num_iters iterations before each move",
+      cxxopts::value<bool>()->default_value("false"))
   ;
 
   auto result = options.parse(argc, argv);
 
   std::string cfg_toml_path = result["cfg"].as<std::string>();
-  int num_iters = result["num_iters"].as<int>();
+  mcts::uct_config uct_cfg;
+  uct_cfg.num_iterations = result["num_iters"].as<int>();
+  uct_cfg.time_limit = result["time_limit"].as<double>();
+  // negative counts would wrap around to huge ones. as 0, a thread count is
+  // rejected by uct and a checkpoint interval keeps only the root's state
+  uct_cfg.checkpoint_interval = std::max(result["checkpoint_interval"].as<int>(), 0);
+  uct_cfg.num_threads = std::max(result["num_threads"].as<int>(), 0);
+  uct_cfg.virtual_loss = result["virtual_loss"].as<double>();
+  if (result["root_parallel"].as<bool>()) {
+    uct_cfg.mode = mcts::parallelism::root;
+  }
+  // a negative interval would wrap around and quietly put off every merge to
+  // the end, so it is taken as the 0 that does that openly
+  uct_cfg.sync_interval = std::max(result["sync_interval"].as<int>(), 0);
+  // likewise rejected by uct if 0
+  uct_cfg.leaf_playouts = std::max(result["leaf_playouts"].as<int>(), 0);
+  uct_cfg.transpositions = result["transpositions"].as<bool>();
 
   same_game::config cfg = same_game::get_config_from_toml(cfg_toml_path);
 
-  same_game::game game(cfg);
-  
-  mcts::node<same_game::game> node(game);
-  mcts::uct uct(node, num_iters);
+  same_game::dispatch_game(cfg, [&](auto game) {
+    mcts::uct uct(game, uct_cfg);
 
-  uct.search();
+    if (result["play"].as<bool>()) {
+      uct.play();
+    } else {
+      uct.search();
+    }
+  });
 
   return 0;
 }
@@ -0,0 +1,37 @@
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+#include "cxxopts.hpp"
+#include "nmcs.hpp"
+#include "same_game.hpp"
+
+int main(int argc, char** argv) {
+  std::srand(std::time(0));
+
+  cxxopts::Options options("same_game_nmcs", "Performs Nested Monte Carlo Search on samegame");
+  options.add_options()
+    ("c,cfg", "Path to game config", cxxopts::value<std::string>()
+      ->default_value("../cfg/same_game.toml"))
+    ("l,level", "Nesting level of the search", cxxopts::value<int>()->default_value("2"))
+    ("t,num_threads", "Number of threads running level 1 searches", cxxopts::value<int>()->default_value("1"))
+  ;
+
+  auto result = options.parse(argc, argv);
+
+  std::string cfg_toml_path = result["cfg"].as<std::string>();
+  int level = result["level"].as<int>();
+  // a negative count would wrap around to a huge one, so it is passed on as 0
+  // for the search to reject
+  std::size_t num_threads = std::max(result["num_threads"].as<int>(), 0);
+
+  same_game::config cfg = same_game::get_config_from_toml(cfg_toml_path);
+
+  same_game::dispatch_game(cfg, [&](auto game) {
+    mcts::nmcs nmcs(game, level, num_threads);
+
+    nmcs.search();
+  });
+
+  return 0;
+}
@@ -0,0 +1,43 @@
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+#include "cxxopts.hpp"
+#include "nrpa.hpp"
+#include "same_game.hpp"
+
+int main(int argc, char** argv) {
+  std::srand(std::time(0));
+
+  cxxopts::Options options("same_game_nrpa", "Performs Nested Rollout Policy Adaptation on samegame");
+  options.add_options()
+    ("c,cfg", "Path to game config", cxxopts::value<std::string>()
+      ->default_value("../cfg/same_game.toml"))
+    ("l,level", "Nesting level of the search", cxxopts::value<int>()->default_value("3"))
+    ("n,num_iterations", "Number of iterations at each level", cxxopts::value<int>()->default_value("100"))
+    ("a,alpha", "Learning rate of the policy", cxxopts::value<double>()->default_value("1"))
+    ("t,num_threads", "Number of threads running level 1 searches", cxxopts::value<int>()->default_value("1"))
+    ("time_limit", "Seconds the search may take, or 0 for no limit", cxxopts::value<double>()->default_value("0"))
+  ;
+
+  auto result = options.parse(argc, argv);
+
+  std::string cfg_toml_path = result["cfg"].as<std::string>();
+  mcts::nrpa_config nrpa_cfg;
+  nrpa_cfg.level = result["level"].as<int>();
+  nrpa_cfg.num_iterations = result["num_iterations"].as<int>();
+  nrpa_cfg.alpha = result["alpha"].as<double>();
+  // keep -t negative from wrapping around; nrpa rejects 0
+  nrpa_cfg.num_threads = std::max(result["num_threads"].as<int>(), 0);
+  nrpa_cfg.time_limit = result["time_limit"].as<double>();
+
+  same_game::config cfg = same_game::get_config_from_toml(cfg_toml_path);
+
+  same_game::dispatch_game(cfg, [&](auto game) {
+    mcts::nrpa nrpa(game, nrpa_cfg);
+
+    nrpa.search();
+  });
+
+  return 0;
+}
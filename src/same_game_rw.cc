@@ -21,35 +21,35 @@ int main(int argc, char** argv) {
 
   same_game::config cfg = same_game::get_config_from_toml(cfg_toml_path);
 
-  using game = same_game::game;
-  
   std::ofstream dkd_f("dkd.same_game.csv");
   std::ofstream td_f("td.same_game.csv");
 
-  game g(cfg);
-
-  g.print();
-
-  for (int i = 0; i < num_walks; i++) {
-    if (i % 1000 == 0) {
-      std::cout << "[" << i << "/" << num_walks << "]" << "\n";
-    }
-
-    game cur(g);
-    auto moves = cur.get_available_moves();
-    int prev_k = moves.size();
-    while (!moves.empty()) {
-      int random_idx = std::rand() % moves.size();
-      cur = cur.make_move(moves[random_idx]);
-      moves = cur.get_available_moves();
-      int k = moves.size();
-      int delta = k - prev_k;
-      prev_k = k;
-      int d = cur.get_num_moves_made();
-      dkd_f << d << ", " << k << ", " << delta << "\n";
+  same_game::dispatch_game(cfg, [&](auto g) {
+    using game = decltype(g);
+
+    g.print();
+
+    for (int i = 0; i < num_walks; i++) {
+      if (i % 1000 == 0) {
+        std::cout << "[" << i << "/" << num_walks << "]" << "\n";
+      }
+
+      game cur(g);
+      auto moves = cur.get_available_moves();
+      int prev_k = moves.size();
+      while (!moves.empty()) {
+        int random_idx = std::rand() % moves.size();
+        cur = cur.make_move(moves[random_idx]);
+        moves = cur.get_available_moves();
+        int k = moves.size();
+        int delta = k - prev_k;
+        prev_k = k;
+        int d = cur.get_num_moves_made();
+        dkd_f << d << ", " << k << ", " << delta << "\n";
+      }
+      td_f << cur.get_num_moves_made() << "\n"; 
     }
-    td_f << cur.get_num_moves_made() << "\n"; 
-  }
+  });
 
   return 0;
 }
@@ -1,6 +1,12 @@
+#include <stdexcept>
+
+#include "beam_search.hpp"
 #include "generic_game.hpp"
 #include "gtest/gtest.h"
 #include "mcts.hpp"
+#include "nmcs.hpp"
+#include "nrpa.hpp"
+#include "same_game.hpp"
 
 class mcts_node_test : public ::testing::Test {
   protected:
@@ -8,84 +14,372 @@ class mcts_node_test : public ::testing::Test {
     generic_game::config cfg_{
       generic_game::get_config_from_toml("../tests/cfg/generic_game.toml")};
     generic_game::game game_{cfg_};
-    mcts::node<generic_game::game> node_{game_};  
+    mcts::tree<generic_game::game> tree_{game_};
+    mcts::index_type root_{tree_.get_root()};
 };
 
 TEST_F(mcts_node_test, expands_correctly_when_able) {
-  auto* node = node_.expand();
-  ASSERT_EQ(node->get_parent(), &node_);
-} 
+  auto node = tree_.expand(root_);
+  ASSERT_EQ(tree_[node].get_parent(), root_);
+}
 
 TEST_F(mcts_node_test, can_expand_until_terminal) {
-  auto* node = &node_;
-  auto* prev = node;
+  auto node = root_;
+  auto prev = node;
 
-  while (node) {
+  while (node != mcts::no_index) {
     prev = node;
-    node = node->expand();
+    node = tree_.expand(node);
   }
 
-  ASSERT_TRUE(prev->is_terminal());
+  ASSERT_TRUE(tree_[prev].is_terminal());
+}
+
+TEST_F(mcts_node_test, expanded_siblings_share_a_block) {
+  auto first = tree_.expand(root_);
+  auto second = tree_.expand(root_);
+  if (second != mcts::no_index) {
+    ASSERT_EQ(second, first + 1);
+    ASSERT_EQ(tree_[root_].get_num_children(), 2);
+  }
 }
 
 TEST_F(mcts_node_test, depth_is_correct_for_root) {
-  ASSERT_EQ(node_.get_depth(), 0);
+  ASSERT_EQ(tree_.get_depth(root_), 0);
 }
 
 TEST_F(mcts_node_test, depth_is_correct_for_depth_1) {
-  auto* node = node_.expand();
-  ASSERT_EQ(node->get_depth(), 1);
+  auto node = tree_.expand(root_);
+  ASSERT_EQ(tree_.get_depth(node), 1);
 }
 
 TEST_F(mcts_node_test, depth_is_correct_for_depth_4) {
-  auto* node = node_.expand();
-  node = node->expand();
-  node = node->expand();
-  node = node->expand();
-  ASSERT_EQ(node->get_depth(), 4);
+  auto node = tree_.expand(root_);
+  node = tree_.expand(node);
+  node = tree_.expand(node);
+  node = tree_.expand(node);
+  ASSERT_EQ(tree_.get_depth(node), 4);
 }
 
 TEST_F(mcts_node_test, get_seq_is_correct_for_root) {
-  ASSERT_EQ(node_.get_seq(), std::vector<int>{});
+  ASSERT_EQ(tree_.get_seq(root_), std::vector<int>{});
 }
 
 TEST_F(mcts_node_test, get_seq_correct_for_depth_1) {
-  auto* node = node_.expand();
-  ASSERT_EQ(node->get_seq().size(), 1);
+  auto node = tree_.expand(root_);
+  ASSERT_EQ(tree_.get_seq(node).size(), 1);
 }
 
 TEST_F(mcts_node_test, get_seq_is_correct_for_depth_4) {
-  auto* node = node_.expand();
-  node = node->expand();
-  node = node->expand();
-  node = node->expand();
-  ASSERT_EQ(node->get_seq().size(), 4);
+  auto node = tree_.expand(root_);
+  node = tree_.expand(node);
+  node = tree_.expand(node);
+  node = tree_.expand(node);
+  ASSERT_EQ(tree_.get_seq(node).size(), 4);
+}
+
+TEST(mcts_tree_test, stateless_nodes_rebuild_their_states) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::tree<same_game::game> full(game);
+  mcts::tree<same_game::game> stateless(game, 0);
+  std::vector<mcts::index_type> expanded{full.get_root()};
+  for (std::size_t i = 0; i < expanded.size(); i++) {
+    for (auto c = full.expand(expanded[i]); c != mcts::no_index; c = full.expand(expanded[i])) {
+      ASSERT_EQ(stateless.expand(expanded[i]), c);
+      expanded.push_back(c);
+    }
+  }
+  ASSERT_EQ(stateless.get_num_states(), 1);
+  same_game::game from_full(game);
+  same_game::game from_stateless(game);
+  for (auto v : expanded) {
+    full.load_state(v, from_full);
+    stateless.load_state(v, from_stateless);
+    ASSERT_EQ(from_full.hash(), from_stateless.hash());
+    ASSERT_EQ(from_full.get_cumulative_reward(), from_stateless.get_cumulative_reward());
+  }
+}
+
+TEST(mcts_tree_test, transpositions_share_a_node) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::tree<same_game::game> plain(game);
+  mcts::tree<same_game::game> merged(game, 1, true);
+  for (std::vector<mcts::index_type> expanded{plain.get_root()}; !expanded.empty(); ) {
+    auto v = expanded.back();
+    expanded.pop_back();
+    for (auto c = plain.expand(v); c != mcts::no_index; c = plain.expand(v)) {
+      expanded.push_back(c);
+    }
+  }
+
+  same_game::game from_parent(game);
+  same_game::game from_child(game);
+  for (std::vector<mcts::index_type> expanded{merged.get_root()}; !expanded.empty(); ) {
+    auto v = expanded.back();
+    expanded.pop_back();
+    for (auto c = merged.expand(v); c != mcts::no_index; c = merged.expand(v)) {
+      auto slot = merged[v].get_first_child() + merged[v].get_num_children() - 1;
+      merged.load_state(v, from_parent);
+      from_parent.apply(merged[slot].get_move());
+      merged.load_state(c, from_child);
+      ASSERT_EQ(from_parent.hash(), from_child.hash());
+      ASSERT_EQ(from_parent.get_cumulative_reward(), from_child.get_cumulative_reward());
+      if (merged[slot].get_link() == mcts::no_index) {
+        expanded.push_back(c);
+      }
+    }
+  }
+  ASSERT_GT(merged.get_num_transpositions(), 0);
+  ASSERT_LT(merged.get_num_nodes(), plain.get_num_nodes());
+}
+
+TEST(mcts_tree_test, parallel_search_counts_every_visit_once) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::uct_config cfg;
+  cfg.num_iterations = 2000;
+  cfg.num_threads = 4;
+  cfg.transpositions = true;
+  mcts::uct<same_game::game> uct(game, cfg);
+  auto status = uct.explore();
+
+  const auto& tree = uct.get_tree();
+  const auto& root = tree[tree.get_root()];
+  ASSERT_EQ(root.get_n(), status.num_iterations);
+  std::size_t children_n = 0;
+  double children_q = 0;
+  for (mcts::index_type i = 0; i < root.get_num_children(); i++) {
+    children_n += tree[tree.get_child(tree.get_root(), i)].get_n();
+    children_q += tree[tree.get_child(tree.get_root(), i)].get_q_total();
+  }
+  ASSERT_EQ(children_n, root.get_n());
+  ASSERT_NEAR(children_q, root.get_q_total(), 1e-6 * std::abs(root.get_q_total()));
+}
+
+TEST(mcts_tree_test, root_parallel_search_merges_root_statistics) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::uct_config cfg;
+  cfg.num_iterations = 2000;
+  cfg.num_threads = 4;
+  cfg.mode = mcts::parallelism::root;
+  mcts::uct<same_game::game> uct(game, cfg);
+  auto status = uct.explore();
+
+  const auto& tree = uct.get_tree();
+  const auto& root = tree[tree.get_root()];
+  std::size_t children_n = 0;
+  for (mcts::index_type i = 0; i < root.get_num_children(); i++) {
+    children_n += tree[tree.get_child(tree.get_root(), i)].get_n();
+  }
+  ASSERT_EQ(root.get_n(), status.num_iterations);
+  ASSERT_EQ(children_n, status.num_iterations);
+}
+
+TEST(mcts_tree_test, leaf_parallel_search_backs_up_one_visit_per_iteration) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::uct_config cfg;
+  cfg.num_iterations = 500;
+  cfg.num_threads = 2;
+  cfg.leaf_playouts = 4;
+  mcts::uct<same_game::game> uct(game, cfg);
+  auto status = uct.explore();
+
+  const auto& tree = uct.get_tree();
+  ASSERT_EQ(tree[tree.get_root()].get_n(), status.num_iterations);
+}
+
+TEST(mcts_tree_test, search_ends_once_the_root_is_solved) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::uct_config cfg;
+  cfg.num_iterations = 100000;
+  cfg.num_threads = 2;
+  cfg.transpositions = true;
+  mcts::uct<same_game::game> uct(game, cfg);
+  auto status = uct.explore();
+
+  const auto& tree = uct.get_tree();
+  const auto& root = tree[tree.get_root()];
+  ASSERT_TRUE(root.is_solved());
+  ASSERT_LT(status.num_iterations, cfg.num_iterations);
+  ASSERT_EQ(root.get_value(), status.high_score);
+}
+
+TEST(mcts_tree_test, rerooting_keeps_the_subtree) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::uct_config cfg;
+  cfg.num_iterations = 300;
+  mcts::uct<same_game::game> uct(game, cfg);
+  uct.search();
+
+  const auto& tree = uct.get_tree();
+  auto child = tree.get_child(tree.get_root(), 0);
+  mcts::tree<same_game::game> rerooted(tree, child);
+  ASSERT_EQ(rerooted[rerooted.get_root()].get_n(), tree[child].get_n());
+  ASSERT_EQ(rerooted[rerooted.get_root()].get_num_children(), tree[child].get_num_children());
+  ASSERT_LT(rerooted.get_num_nodes(), tree.get_num_nodes());
+  for (mcts::index_type i = 0; i < tree[child].get_num_children(); i++) {
+    ASSERT_EQ(rerooted[rerooted.get_child(rerooted.get_root(), i)].get_n(), tree[tree.get_child(child, i)].get_n());
+  }
+}
+
+TEST(mcts_tree_test, play_reaches_the_end_of_the_game) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::uct_config cfg;
+  cfg.num_iterations = 100;
+  cfg.transpositions = true;
+  mcts::uct<same_game::game> uct(game, cfg);
+  auto moves = uct.play();
+
+  for (auto move : moves) {
+    game.apply(move);
+  }
+  ASSERT_TRUE(game.get_available_moves().empty());
+}
+
+TEST(mcts_tree_test, play_reaches_the_end_without_search_time) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::uct_config cfg;
+  cfg.num_iterations = 0;
+  cfg.time_limit = 1e-12;
+  mcts::uct<same_game::game> uct(game, cfg);
+  auto moves = uct.play();
+
+  ASSERT_FALSE(moves.empty());
+  for (auto move : moves) {
+    game.apply(move);
+  }
+  ASSERT_TRUE(game.get_available_moves().empty());
+}
+
+TEST(mcts_tree_test, search_can_be_stopped_from_the_progress_callback) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::uct_config cfg;
+  cfg.num_iterations = 0;
+  cfg.time_limit = 60;
+  mcts::uct<same_game::game> uct(game, cfg);
+  uct.set_progress_callback([&uct](const auto& status) {
+    if (status.num_iterations >= 50) {
+      uct.stop();
+    }
+  }, 0);
+  auto status = uct.explore();
+
+  ASSERT_EQ(status.num_iterations, 50);
+  std::size_t root_visits = 0;
+  for (const auto& [move, n] : status.root_visits) {
+    root_visits += n;
+  }
+  ASSERT_EQ(root_visits, 50);
+  ASSERT_FALSE(status.best_seq.empty());
+}
+
+TEST(nmcs_test, best_sequence_reaches_its_score) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::nmcs<same_game::game> nmcs(game, 2, 3);
+  auto best = nmcs.search();
+
+  for (auto move : best.moves) {
+    game.apply(move);
+  }
+  ASSERT_TRUE(game.get_available_moves().empty());
+  ASSERT_EQ(game.get_cumulative_reward(), best.score);
+}
+
+TEST(nmcs_test, rejects_invalid_settings) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  EXPECT_THROW(mcts::nmcs<same_game::game>(game, 0), std::invalid_argument);
+  EXPECT_THROW(mcts::nmcs<same_game::game>(game, 2, 0), std::invalid_argument);
+}
+
+TEST(nrpa_test, best_sequence_reaches_its_score) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::nrpa_config cfg;
+  cfg.level = 2;
+  cfg.num_iterations = 10;
+  cfg.num_threads = 3;
+  mcts::nrpa<same_game::game> nrpa(game, cfg);
+  auto status = nrpa.explore();
+
+  ASSERT_EQ(status.num_iterations, 100);
+  for (auto move : status.best_seq) {
+    game.apply(move);
+  }
+  ASSERT_TRUE(game.get_available_moves().empty());
+  ASSERT_EQ(game.get_cumulative_reward(), status.high_score);
+}
+
+TEST(nrpa_test, rejects_invalid_settings) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::nrpa_config cfg;
+  cfg.level = 0;
+  EXPECT_THROW(mcts::nrpa<same_game::game>(game, cfg), std::invalid_argument);
+  cfg.level = 2;
+  cfg.num_threads = 0;
+  EXPECT_THROW(mcts::nrpa<same_game::game>(game, cfg), std::invalid_argument);
+}
+
+TEST(beam_search_test, best_sequence_reaches_its_score) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::beam_config cfg;
+  cfg.width = 20;
+  cfg.num_threads = 3;
+  mcts::beam_search<same_game::game> beam(game, cfg);
+  auto status = beam.explore();
+
+  for (auto move : status.best_seq) {
+    game.apply(move);
+  }
+  ASSERT_TRUE(game.get_available_moves().empty());
+  ASSERT_EQ(game.get_cumulative_reward(), status.high_score);
+}
+
+TEST(beam_search_test, rejects_invalid_settings) {
+  same_game::game game(same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml"));
+  mcts::beam_config cfg;
+  cfg.width = 0;
+  EXPECT_THROW(mcts::beam_search<same_game::game>(game, cfg), std::invalid_argument);
+  cfg.width = 10;
+  cfg.num_threads = 0;
+  EXPECT_THROW(mcts::beam_search<same_game::game>(game, cfg), std::invalid_argument);
 }
 
 class uct_test : public ::testing::Test {
   protected:
     using config_type = generic_game::config;
     using game_type = generic_game::game;
-    using node_type = mcts::node<game_type>;
-    using uct_type = mcts::uct<node_type>;
+    using uct_type = mcts::uct<game_type>;
 
     void SetUp() override {}
     
     config_type cfg_{generic_game::get_config_from_toml("../tests/cfg/generic_game.toml")};
     game_type game_{cfg_};
-    node_type node_{game_};
-    uct_type uct_{node_};
+    uct_type uct_{game_};
+    mcts::index_type root_{uct_.get_tree().get_root()};
 };
 
 
 TEST_F(uct_test, tree_policy_returns_non_null) {
-  auto* node = uct_.tree_policy(&node_);
-  ASSERT_TRUE(node);
-  ASSERT_NE(node, &node_);
+  auto node = uct_.tree_policy(root_);
+  ASSERT_NE(node, mcts::no_index);
+  ASSERT_NE(node, root_);
+}
+
+TEST_F(uct_test, transpositions_need_a_hash) {
+  mcts::uct_config cfg;
+  cfg.transpositions = true;
+  EXPECT_THROW(uct_type(game_, cfg), std::invalid_argument);
+}
+
+TEST_F(uct_test, rejects_invalid_settings) {
+  mcts::uct_config cfg;
+  cfg.num_threads = 0;
+  EXPECT_THROW(uct_type(game_, cfg), std::invalid_argument);
+  cfg.num_threads = 1;
+  cfg.leaf_playouts = 0;
+  EXPECT_THROW(uct_type(game_, cfg), std::invalid_argument);
 }
 
 TEST_F(uct_test, default_policy_returns_reward) {
-  double reward = uct_.default_policy(&node_);
+  double reward = uct_.default_policy(root_);
   ASSERT_NE(reward, 0);
 }
 
@@ -1,5 +1,13 @@
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <stdexcept>
+
 #include "gtest/gtest.h"
+#include "playout_state.hpp"
 #include "same_game.hpp"
+#include "same_game_batch.hpp"
 
 class same_game_test : public ::testing::Test {
   protected:
@@ -14,6 +22,166 @@ TEST_F(same_game_test, correctly_inits_from_toml) {
   EXPECT_EQ(cfg_.height, 15);
 }
 
+TEST_F(same_game_test, rejects_boards_too_big_for_a_position) {
+  EXPECT_THROW(same_game::game(same_game::config{17, 15, ""}), std::invalid_argument);
+  EXPECT_THROW(same_game::game(same_game::config{15, 0, ""}), std::invalid_argument);
+  EXPECT_THROW(same_game::game(same_game::config{3, 3, "../tests/cfg/sg_layout_small"}), std::invalid_argument);
+}
+
+TEST_F(same_game_test, incremental_relabel_matches_full_relabel) {
+  std::minstd_rand rng(11);
+  for (int board = 0; board < 20; board++) {
+    std::srand(board);
+    same_game::game game(same_game::config{15, 15, ""});
+    while (game.has_available_moves()) {
+      const auto& moves = game.get_available_moves();
+      game.apply(moves[rng() % moves.size()]);
+
+      same_game::game fresh(game);
+      same_game::game_exposer<same_game::game> incremental(game);
+      same_game::game_exposer<same_game::game> full(fresh);
+      full.relabel();
+      ASSERT_TRUE(std::equal(moves.begin(), moves.end(), fresh.get_available_moves().begin(),
+                             fresh.get_available_moves().end()));
+      for (int col = 0; col < 15; col++) {
+        for (int row = 0; row < 15; row++) {
+          ASSERT_EQ(incremental.get_label(col, row), full.get_label(col, row));
+        }
+      }
+      for (int label = 0; label < static_cast<int>(moves.size()); label++) {
+        ASSERT_EQ(incremental.get_group_size(label), full.get_group_size(label));
+      }
+    }
+  }
+}
+
+class same_game_layout_test : public ::testing::Test {
+  protected:
+    using move_type = same_game::game::move_type;
+    void SetUp() override {}
+
+    template <class Game>
+    static std::vector<move_type> moves_of(const Game& game) {
+      const auto& moves = game.get_available_moves();
+      return std::vector<move_type>(moves.begin(), moves.end());
+    }
+
+    same_game::config cfg_{
+      same_game::get_config_from_toml("../tests/cfg/same_game_layout.toml")
+    };
+    same_game::game game_{cfg_};
+};
+
+TEST_F(same_game_layout_test, finds_one_move_per_chain) {
+  std::vector<move_type> expected = {{0, 0}, {0, 2}, {2, 0}, {2, 1}, {3, 1}};
+  EXPECT_EQ(moves_of(game_), expected);
+}
+
+TEST_F(same_game_layout_test, make_move_scores_removed_chain) {
+  auto next = game_.make_move({0, 0});
+  EXPECT_EQ(next.get_cumulative_reward(), 1);
+  EXPECT_EQ(next.get_num_moves_made(), 1);
+  EXPECT_EQ(game_.get_available_moves().size(), 5);
+}
+
+TEST_F(same_game_layout_test, color_counts_track_removed_chains) {
+  EXPECT_EQ(game_.get_color_counts()[1], 4);
+  EXPECT_EQ(game_.get_color_counts()[2], 5);
+  EXPECT_EQ(game_.get_color_counts()[3], 3);
+  auto next = game_.make_move({0, 0});
+  EXPECT_EQ(next.get_color_counts()[2], 2);
+  EXPECT_EQ(next.get_num_tiles(), 9);
+}
+
+TEST_F(same_game_layout_test, score_upper_bound_is_admissible) {
+  std::function<double(const same_game::game&)> best_reward = [&](const same_game::game& game) {
+    double best = game.get_cumulative_reward();
+    for (auto move : game.get_available_moves()) {
+      best = std::max(best, best_reward(game.make_move(move)));
+    }
+    return best;
+  };
+  EXPECT_GE(game_.get_score_upper_bound(), best_reward(game_));
+  auto next = game_.make_move({0, 0});
+  EXPECT_GE(next.get_score_upper_bound(), best_reward(next) - next.get_cumulative_reward());
+}
+
+TEST_F(same_game_layout_test, make_move_accepts_any_tile_of_chain) {
+  auto from_move = game_.make_move({0, 0});
+  auto from_tile = game_.make_move({1, 0});
+  EXPECT_EQ(from_tile.get_cumulative_reward(), from_move.get_cumulative_reward());
+  EXPECT_EQ(moves_of(from_tile), moves_of(from_move));
+}
+
+TEST_F(same_game_layout_test, hash_matches_across_move_orders) {
+  auto a = game_.make_move({2, 1}).make_move({3, 1});
+  auto b = game_.make_move({3, 1}).make_move({2, 1});
+  EXPECT_EQ(a.hash(), b.hash());
+  EXPECT_NE(a.hash(), game_.hash());
+  EXPECT_NE(game_.make_move({2, 1}).hash(), game_.make_move({3, 1}).hash());
+}
+
+TEST_F(same_game_layout_test, apply_matches_make_move) {
+  auto copy = game_;
+  copy.apply({2, 1});
+  auto next = game_.make_move({2, 1});
+  EXPECT_EQ(copy.hash(), next.hash());
+  EXPECT_EQ(moves_of(copy), moves_of(next));
+  EXPECT_EQ(copy.get_num_moves_made(), 1);
+}
+
+TEST_F(same_game_layout_test, random_playout_matches_applied_moves) {
+  std::minstd_rand rng(7);
+  std::vector<same_game::game::move_type> seq;
+  auto played = game_;
+  auto result = same_game::random_playout(played, rng, [&](auto move) { seq.push_back(move); });
+  auto replayed = game_;
+  for (auto move : seq) {
+    replayed.apply(move);
+  }
+  EXPECT_FALSE(played.has_available_moves());
+  EXPECT_EQ(result.num_moves, static_cast<int>(seq.size()));
+  EXPECT_EQ(result.reward, replayed.get_cumulative_reward());
+  EXPECT_EQ(played.hash(), replayed.hash());
+  EXPECT_EQ(played.get_num_moves_made(), replayed.get_num_moves_made());
+}
+
+TEST_F(same_game_layout_test, playout_batch_matches_applied_moves) {
+  std::minstd_rand rng(7);
+  same_game::playout_batch<same_game::game, 16> batch;
+  std::vector<std::vector<same_game::game::move_type>> seqs(16);
+  batch.play_out(game_, rng, [&](int lane, auto move) { seqs[lane].push_back(move); });
+  for (int i = 0; i < 16; i++) {
+    auto replayed = game_;
+    for (auto move : seqs[i]) {
+      replayed.apply(move);
+    }
+    EXPECT_FALSE(replayed.has_available_moves());
+    EXPECT_EQ(batch.get_num_moves()[i], static_cast<int>(seqs[i].size()));
+    EXPECT_EQ(batch.get_rewards()[i], replayed.get_cumulative_reward());
+  }
+}
+
+TEST_F(same_game_layout_test, random_playouts_returns_one_reward_per_playout) {
+  std::minstd_rand rng(7);
+  for (std::size_t n : {1, 16, 17, 40}) {
+    auto rewards = same_game::random_playouts(game_, n, rng);
+    ASSERT_EQ(rewards.size(), n);
+    for (double reward : rewards) {
+      EXPECT_GE(reward, -100);
+    }
+  }
+}
+
+TEST_F(same_game_layout_test, fixed_size_game_matches_dynamic) {
+  same_game::basic_game<4, 3> fixed(cfg_);
+  EXPECT_EQ(moves_of(fixed), moves_of(game_));
+  auto fixed_next = fixed.make_move({0, 0});
+  auto next = game_.make_move({0, 0});
+  EXPECT_EQ(moves_of(fixed_next), moves_of(next));
+  EXPECT_EQ(fixed_next.get_cumulative_reward(), next.get_cumulative_reward());
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();